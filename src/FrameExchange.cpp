@@ -0,0 +1,62 @@
+#include "FrameExchange.h"
+
+#include <cstring>
+
+namespace {
+    uint32_t bytesPerPixel(FrameFormat format) {
+        switch (format) {
+            case frameFormatRgb565:
+                return 2;
+
+            case frameFormatIndexed8:
+                return 1;
+
+            default:
+                return 4;
+        }
+    }
+}  // namespace
+
+FrameExchange::FrameExchange(uint32_t width, uint32_t height) : width(width), height(height) {
+    for (auto& frame : frames) {
+        frame.data = std::make_unique<uint32_t[]>(width * height);
+        frame.damageSpans = std::make_unique<FrameDamageSpan[]>(height / 2 + 1);
+    }
+}
+
+bool FrameExchange::Publish(SoC* soc) {
+    const uint32_t* data = socGetPendingFrame(soc);
+    if (!data) return false;
+
+    Frame& frame = frames[backIndex];
+
+    frame.format = socGetPendingFrameFormat(soc);
+    memcpy(frame.data.get(), data, width * height * bytesPerPixel(frame.format));
+
+    if (frame.format == frameFormatIndexed8)
+        memcpy(frame.palette, socGetPendingFramePalette(soc), sizeof(frame.palette));
+
+    uint32_t nSpans;
+    const FrameDamageSpan* spans = socGetPendingFrameDamage(soc, &nSpans);
+
+    memcpy(frame.damageSpans.get(), spans, nSpans * sizeof(FrameDamageSpan));
+    frame.nDamageSpans = nSpans;
+
+    // If the previous frame is still waiting its damage would be lost. Checking before the
+    // exchange errs on the safe side if the consumer grabs it in the meantime.
+    frame.fullUpdate = middleIndex.load(std::memory_order_acquire) & FRESH;
+
+    socResetPendingFrame(soc);
+
+    backIndex = middleIndex.exchange(backIndex | FRESH, std::memory_order_acq_rel) & ~FRESH;
+
+    return true;
+}
+
+const Frame* FrameExchange::Acquire() {
+    if (!(middleIndex.load(std::memory_order_relaxed) & FRESH)) return nullptr;
+
+    frontIndex = middleIndex.exchange(frontIndex, std::memory_order_acq_rel) & ~FRESH;
+
+    return &frames[frontIndex];
+}
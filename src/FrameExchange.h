@@ -0,0 +1,55 @@
+#ifndef _FRAME_EXCHANGE_H_
+#define _FRAME_EXCHANGE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "SoC.h"
+
+struct Frame {
+    FrameFormat format{frameFormatAbgr8888};
+    std::unique_ptr<uint32_t[]> data;
+    uint32_t palette[256];
+
+    std::unique_ptr<FrameDamageSpan[]> damageSpans;
+    uint32_t nDamageSpans{0};
+
+    // The damage does not cover everything that changed since the last frame that was picked
+    // up by the consumer
+    bool fullUpdate{true};
+};
+
+// Lock-free triple buffer that hands completed frames from the emulation thread to a single
+// consumer thread. The consumer always gets the most recent frame; frames that are replaced
+// before they are picked up are dropped.
+class FrameExchange {
+   public:
+    FrameExchange(uint32_t width, uint32_t height);
+
+    // Emulation thread: copy and reset the pending frame of the SoC. Returns false if there
+    // is none.
+    bool Publish(SoC* soc);
+
+    // Consumer thread: the latest frame or nullptr if nothing was published since the last
+    // call. The frame stays valid until the next call.
+    const Frame* Acquire();
+
+   private:
+    static constexpr uint8_t FRESH = 0x80;
+
+    const uint32_t width;
+    const uint32_t height;
+
+    Frame frames[3];
+
+    uint8_t backIndex{0};
+    uint8_t frontIndex{1};
+    std::atomic<uint8_t> middleIndex{2};
+
+   private:
+    FrameExchange(const FrameExchange&) = delete;
+    FrameExchange& operator=(const FrameExchange&) = delete;
+};
+
+#endif  // _FRAME_EXCHANGE_H_
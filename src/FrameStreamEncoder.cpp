@@ -0,0 +1,163 @@
+#include "FrameStreamEncoder.h"
+
+#include <cstring>
+
+#include "uarm_endian.h"
+
+using namespace std;
+
+namespace {
+    constexpr uint32_t MAX_PACKET_PIXELS = 128;
+
+    uint32_t bytesPerPixel(FrameFormat format) {
+        switch (format) {
+            case frameFormatRgb565:
+                return 2;
+
+            case frameFormatIndexed8:
+                return 1;
+
+            default:
+                return 4;
+        }
+    }
+
+    void putPixel(vector<uint8_t>& out, uint8_t pixel) { out.push_back(pixel); }
+
+    void putPixel(vector<uint8_t>& out, uint16_t pixel) {
+        pixel = htole16(pixel);
+
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&pixel);
+        out.insert(out.end(), bytes, bytes + sizeof(pixel));
+    }
+
+    void putPixel(vector<uint8_t>& out, uint32_t pixel) {
+        pixel = htole32(pixel);
+
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&pixel);
+        out.insert(out.end(), bytes, bytes + sizeof(pixel));
+    }
+
+    template <typename T>
+    void encodeRle(vector<uint8_t>& out, const T* pixels, uint32_t nPixels) {
+        uint32_t i = 0;
+
+        while (i < nPixels) {
+            uint32_t run = 1;
+            while (i + run < nPixels && run < MAX_PACKET_PIXELS && pixels[i + run] == pixels[i])
+                run++;
+
+            if (run > 1) {
+                out.push_back(0x80 | (run - 1));
+                putPixel(out, pixels[i]);
+
+                i += run;
+                continue;
+            }
+
+            const uint32_t first = i;
+            while (i < nPixels && i - first < MAX_PACKET_PIXELS) {
+                if (i + 1 < nPixels && pixels[i + 1] == pixels[i]) break;
+                i++;
+            }
+
+            out.push_back(i - first - 1);
+            for (uint32_t j = first; j < i; j++) putPixel(out, pixels[j]);
+        }
+    }
+}  // namespace
+
+FrameStreamEncoder::FrameStreamEncoder(uint32_t width, uint32_t height)
+    : width(width), height(height) {
+    buffer.reserve(width * height * 4);
+}
+
+const vector<uint8_t>& FrameStreamEncoder::EncodeHeader() {
+    keyframeRequired = true;
+
+    buffer.clear();
+    buffer.insert(buffer.end(), {'U', 'A', 'R', 'M', 'F', 'R', 'M', '1'});
+    Put16(width);
+    Put16(height);
+
+    return buffer;
+}
+
+const vector<uint8_t>& FrameStreamEncoder::EncodeFrame(const Frame& frame) {
+    const bool keyframe = keyframeRequired || frame.fullUpdate || frame.format != lastFormat;
+    const bool sendPalette = frame.format == frameFormatIndexed8 &&
+                             (keyframe || memcmp(frame.palette, lastPalette, sizeof(lastPalette)));
+
+    keyframeRequired = false;
+    lastFormat = frame.format;
+    if (sendPalette) memcpy(lastPalette, frame.palette, sizeof(lastPalette));
+
+    const FrameDamageSpan fullFrame = {.firstRow = 0, .nRows = static_cast<uint16_t>(height)};
+    const FrameDamageSpan* spans = keyframe ? &fullFrame : frame.damageSpans.get();
+    const uint32_t nSpans = keyframe ? 1 : frame.nDamageSpans;
+
+    buffer.clear();
+    Put32(0);
+
+    Put8(frame.format);
+    Put8((keyframe ? FRAME_STREAM_FLAG_KEYFRAME : 0) |
+         (sendPalette ? FRAME_STREAM_FLAG_PALETTE : 0));
+    Put16(nSpans);
+    Put32(frameNumber++);
+
+    if (sendPalette)
+        for (uint32_t i = 0; i < 256; i++) Put32(frame.palette[i]);
+
+    const uint32_t pixelSize = bytesPerPixel(frame.format);
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(frame.data.get());
+
+    for (uint32_t i = 0; i < nSpans; i++) {
+        Put16(spans[i].firstRow);
+        Put16(spans[i].nRows);
+
+        const size_t lengthOffset = buffer.size();
+        Put32(0);
+
+        EncodeRle(buffer, data + spans[i].firstRow * width * pixelSize, spans[i].nRows * width,
+                  pixelSize);
+
+        Patch32(lengthOffset, buffer.size() - lengthOffset - 4);
+    }
+
+    Patch32(0, buffer.size() - 4);
+
+    return buffer;
+}
+
+void FrameStreamEncoder::EncodeRle(vector<uint8_t>& out, const uint8_t* pixels, uint32_t nPixels,
+                                   uint32_t bytesPerPixel) {
+    switch (bytesPerPixel) {
+        case 1:
+            encodeRle(out, pixels, nPixels);
+            break;
+
+        case 2:
+            encodeRle(out, reinterpret_cast<const uint16_t*>(pixels), nPixels);
+            break;
+
+        default:
+            encodeRle(out, reinterpret_cast<const uint32_t*>(pixels), nPixels);
+            break;
+    }
+}
+
+void FrameStreamEncoder::Put8(uint8_t value) { buffer.push_back(value); }
+
+void FrameStreamEncoder::Put16(uint16_t value) {
+    Put8(value);
+    Put8(value >> 8);
+}
+
+void FrameStreamEncoder::Put32(uint32_t value) {
+    Put16(value);
+    Put16(value >> 16);
+}
+
+void FrameStreamEncoder::Patch32(size_t offset, uint32_t value) {
+    for (size_t i = 0; i < 4; i++) buffer[offset + i] = value >> (8 * i);
+}
@@ -0,0 +1,57 @@
+#ifndef _FRAME_STREAM_ENCODER_H_
+#define _FRAME_STREAM_ENCODER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "FrameExchange.h"
+
+// Encodes frames into a byte stream. All integers and pixels are little endian.
+//
+// The stream starts with the 8 byte magic "UARMFRM1", followed by u16 width and u16 height.
+// Each frame follows as a u32 payload length and the payload:
+//
+//   u8 format (enum FrameFormat), u8 flags, u16 span count, u32 frame number
+//   [256 x u32 ABGR palette if flags & FRAME_STREAM_FLAG_PALETTE]
+//   per span: u16 first row, u16 row count, u32 data length, RLE data
+//
+// The RLE data covers the rows of the span in the pixel size of the format. It is a
+// sequence of packets with a u8 header: if bit 7 is set the next pixel repeats
+// (header & 0x7f) + 1 times, otherwise (header + 1) literal pixels follow.
+//
+// Spans only cover rows that changed since the previous frame unless the keyframe flag is
+// set, in which case there is a single span that covers the whole frame.
+class FrameStreamEncoder {
+   public:
+    static constexpr uint8_t FRAME_STREAM_FLAG_KEYFRAME = 0x01;
+    static constexpr uint8_t FRAME_STREAM_FLAG_PALETTE = 0x02;
+
+   public:
+    FrameStreamEncoder(uint32_t width, uint32_t height);
+
+    // The returned buffers stay valid until the next call
+    const std::vector<uint8_t>& EncodeHeader();
+    const std::vector<uint8_t>& EncodeFrame(const Frame& frame);
+
+    static void EncodeRle(std::vector<uint8_t>& out, const uint8_t* pixels, uint32_t nPixels,
+                          uint32_t bytesPerPixel);
+
+   private:
+    void Put8(uint8_t value);
+    void Put16(uint16_t value);
+    void Put32(uint32_t value);
+    void Patch32(size_t offset, uint32_t value);
+
+   private:
+    const uint32_t width;
+    const uint32_t height;
+
+    std::vector<uint8_t> buffer;
+
+    uint32_t frameNumber{0};
+    bool keyframeRequired{true};
+    FrameFormat lastFormat{frameFormatAbgr8888};
+    uint32_t lastPalette[256];
+};
+
+#endif  // _FRAME_STREAM_ENCODER_H_
@@ -0,0 +1,119 @@
+#include "FrameStreamWriter.h"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+    constexpr uint32_t POLL_USEC = 1000000 / 120;
+}
+
+FrameStreamWriter::FrameStreamWriter(FrameExchange& frameExchange, int fd, uint32_t width,
+                                     uint32_t height)
+    : frameExchange(frameExchange), fd(fd), encoder(width, height) {}
+
+FrameStreamWriter::~FrameStreamWriter() { Stop(); }
+
+void FrameStreamWriter::Start() {
+    if (thread.joinable()) return;
+
+    stop = false;
+    streaming = true;
+    thread = std::thread(&FrameStreamWriter::Run, this);
+}
+
+void FrameStreamWriter::Stop() {
+    if (!thread.joinable()) return;
+
+    stop = true;
+    thread.join();
+}
+
+bool FrameStreamWriter::IsStreaming() const { return streaming; }
+
+int FrameStreamWriter::OpenTarget(const char* target) {
+    if (strncmp(target, "fd:", 3) == 0) return atoi(target + 3);
+
+    if (strncmp(target, "unix:", 5) == 0) {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+
+        if (strlen(target + 5) >= sizeof(addr.sun_path)) {
+            cerr << "socket path too long: " << target + 5 << endl;
+            return -1;
+        }
+
+        strcpy(addr.sun_path, target + 5);
+
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            cerr << "unable to connect to " << target + 5 << ": " << strerror(errno) << endl;
+            close(fd);
+
+            return -1;
+        }
+
+        return fd;
+    }
+
+    const int fd = open(target, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) cerr << "unable to open " << target << ": " << strerror(errno) << endl;
+
+    return fd;
+}
+
+void FrameStreamWriter::Run() {
+    if (!Write(encoder.EncodeHeader())) {
+        cerr << "unable to write frame stream header" << endl;
+        streaming = false;
+
+        return;
+    }
+
+    while (!stop) {
+        const Frame* frame = frameExchange.Acquire();
+
+        if (!frame) {
+            usleep(POLL_USEC);
+            continue;
+        }
+
+        if (!Write(encoder.EncodeFrame(*frame))) {
+            cerr << "frame stream closed" << endl;
+            streaming = false;
+
+            return;
+        }
+    }
+}
+
+bool FrameStreamWriter::Write(const vector<uint8_t>& buffer) {
+    const uint8_t* data = buffer.data();
+    size_t remaining = buffer.size();
+
+    while (remaining > 0) {
+        const ssize_t written = write(fd, data, remaining);
+
+        if (written < 0) {
+            if (errno == EINTR) continue;
+
+            return false;
+        }
+
+        data += written;
+        remaining -= written;
+    }
+
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef _FRAME_STREAM_WRITER_H_
+#define _FRAME_STREAM_WRITER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "FrameExchange.h"
+#include "FrameStreamEncoder.h"
+
+// Encodes frames from a frame exchange on a separate thread and writes them to a file
+// descriptor. See FrameStreamEncoder for the format.
+class FrameStreamWriter {
+   public:
+    FrameStreamWriter(FrameExchange& frameExchange, int fd, uint32_t width, uint32_t height);
+    ~FrameStreamWriter();
+
+    void Start();
+    void Stop();
+
+    // Turns false if writing failed, usually because the reader went away
+    bool IsStreaming() const;
+
+    // fd:N for an open descriptor, unix:PATH for a stream socket, anything else is a file.
+    // Returns -1 on failure.
+    static int OpenTarget(const char* target);
+
+   private:
+    void Run();
+
+    bool Write(const std::vector<uint8_t>& data);
+
+   private:
+    FrameExchange& frameExchange;
+    const int fd;
+
+    FrameStreamEncoder encoder;
+
+    std::thread thread;
+    std::atomic<bool> stop{false};
+    std::atomic<bool> streaming{false};
+
+   private:
+    FrameStreamWriter(const FrameStreamWriter&) = delete;
+    FrameStreamWriter& operator=(const FrameStreamWriter&) = delete;
+};
+
+#endif  // _FRAME_STREAM_WRITER_H_
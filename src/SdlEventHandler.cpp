@@ -2,6 +2,8 @@
 
 #include <SDL.h>
 
+#include <iostream>
+
 #include "keys.h"
 
 namespace {
@@ -43,7 +45,8 @@ namespace {
     }
 }  // namespace
 
-SdlEventHandler::SdlEventHandler(struct SoC* soc, int scale) : soc(soc), scale(scale) {}
+SdlEventHandler::SdlEventHandler(SpscQueue<InputEvent>& inputQueue, int scale)
+    : inputQueue(inputQueue), scale(scale) {}
 
 void SdlEventHandler::HandleEvents() {
     SDL_Event event;
@@ -51,38 +54,40 @@ void SdlEventHandler::HandleEvents() {
     while (SDL_PollEvent(&event)) {
         switch (event.type) {
             case SDL_QUIT:
-                exit(0);
+                quitRequested = true;
                 break;
 
             case SDL_MOUSEBUTTONDOWN:
                 if (event.button.button != SDL_BUTTON_LEFT) break;
                 penDown = true;
-                socPenDown(soc, event.button.x / scale, event.button.y / scale);
+                Post(InputEvent::Type::penDown, keyInvalid, event.button.x / scale,
+                     event.button.y / scale);
 
                 break;
 
             case SDL_MOUSEBUTTONUP:
                 if (event.button.button != SDL_BUTTON_LEFT) break;
                 penDown = false;
-                socPenUp(soc);
+                Post(InputEvent::Type::penUp);
 
                 break;
 
             case SDL_MOUSEMOTION:
                 if (!penDown) break;
-                socPenDown(soc, event.motion.x / scale, event.motion.y / scale);
+                Post(InputEvent::Type::penDown, keyInvalid, event.motion.x / scale,
+                     event.motion.y / scale);
 
                 break;
 
             case SDL_KEYDOWN: {
                 enum KeyId key = mapKey(event.key.keysym.sym);
-                if (key) socKeyDown(soc, key);
+                if (key) Post(InputEvent::Type::keyDown, key);
                 break;
             }
 
             case SDL_KEYUP: {
                 enum KeyId key = mapKey(event.key.keysym.sym);
-                if (key) socKeyUp(soc, key);
+                if (key) Post(InputEvent::Type::keyUp, key);
                 break;
             }
 
@@ -96,3 +101,30 @@ void SdlEventHandler::HandleEvents() {
 bool SdlEventHandler::RedrawRequested() const { return redrawRequested; }
 
 void SdlEventHandler::ClearRedrawRequested() { redrawRequested = false; }
+
+bool SdlEventHandler::QuitRequested() const { return quitRequested; }
+
+void SdlEventHandler::Post(InputEvent::Type type, enum KeyId key, int x, int y) {
+    if (!inputQueue.Push({.type = type, .key = key, .x = x, .y = y}))
+        std::cerr << "input queue overflow, event dropped" << std::endl;
+}
+
+void SdlEventHandler::Dispatch(struct SoC* soc, const InputEvent& event) {
+    switch (event.type) {
+        case InputEvent::Type::penDown:
+            socPenDown(soc, event.x, event.y);
+            break;
+
+        case InputEvent::Type::penUp:
+            socPenUp(soc);
+            break;
+
+        case InputEvent::Type::keyDown:
+            socKeyDown(soc, event.key);
+            break;
+
+        case InputEvent::Type::keyUp:
+            socKeyUp(soc, event.key);
+            break;
+    }
+}
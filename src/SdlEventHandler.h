@@ -2,22 +2,40 @@
 #define _SDL_EVENT_HANDLER_
 
 #include "SoC.h"
+#include "spsc_queue.h"
+
+struct InputEvent {
+    enum class Type : uint8_t { penDown, penUp, keyDown, keyUp };
+
+    Type type;
+    enum KeyId key;
+    int x, y;
+};
 
 class SdlEventHandler {
    public:
-    SdlEventHandler(struct SoC* soc, int scale);
+    SdlEventHandler(SpscQueue<InputEvent>& inputQueue, int scale);
 
     void HandleEvents();
 
     bool RedrawRequested() const;
     void ClearRedrawRequested();
 
+    bool QuitRequested() const;
+
+    // Called on the emulation thread for events taken from the queue
+    static void Dispatch(struct SoC* soc, const InputEvent& event);
+
+   private:
+    void Post(InputEvent::Type type, enum KeyId key = keyInvalid, int x = 0, int y = 0);
+
    private:
-    struct SoC* soc;
+    SpscQueue<InputEvent>& inputQueue;
 
     bool penDown{false};
     int scale{1};
     bool redrawRequested{false};
+    bool quitRequested{false};
 
    private:
     SdlEventHandler();
@@ -2,6 +2,7 @@
 
 #include "SDL_image.h"
 #include "Silkscreen.h"
+#include "lcd_convert.h"
 
 namespace {
     SDL_Texture* loadSilkscreen(SDL_Renderer* renderer) {
@@ -17,13 +18,19 @@ namespace {
     }
 }  // namespace
 
-SdlRenderer::SdlRenderer(SDL_Window* window, SDL_Renderer* renderer, SoC* soc, int scale)
-    : window(window), renderer(renderer), soc(soc), scale(scale) {
+SdlRenderer::SdlRenderer(SDL_Window* window, SDL_Renderer* renderer, int scale)
+    : window(window), renderer(renderer), scale(scale) {
     deviceGetDisplayConfiguration(&displayConfiguration);
 
     frameTexture =
         SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STREAMING,
                           displayConfiguration.width, displayConfiguration.height);
+    frameTextureRgb565 =
+        SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB565, SDL_TEXTUREACCESS_STREAMING,
+                          displayConfiguration.width, displayConfiguration.height);
+
+    indexedFrameBuffer =
+        std::make_unique<uint32_t[]>(displayConfiguration.width * displayConfiguration.height);
 
     silkscreenTexture = loadSilkscreen(renderer);
 
@@ -33,28 +40,10 @@ SdlRenderer::SdlRenderer(SDL_Window* window, SDL_Renderer* renderer, SoC* soc, i
     SDL_RenderPresent(renderer);
 }
 
-void SdlRenderer::Draw(bool forceRedraw) {
-    uint32_t* frame = socGetPendingFrame(soc);
+void SdlRenderer::Draw(const Frame* frame, bool forceRedraw) {
     if (!frame && !forceRedraw) return;
 
-    if (frame) {
-        uint8_t* pixels;
-        int pitch;
-        SDL_LockTexture(frameTexture, NULL, (void**)&pixels, &pitch);
-
-        if (pitch == 4 * displayConfiguration.width) {
-            memcpy(pixels, frame, 4 * displayConfiguration.width * displayConfiguration.height);
-        } else {
-            for (int y = 0; y < displayConfiguration.height; y++) {
-                memcpy(pixels, frame, 4 * displayConfiguration.width);
-                frame += displayConfiguration.width;
-                pixels += pitch;
-            }
-        }
-
-        SDL_UnlockTexture(frameTexture);
-        frameTextureValid = true;
-    }
+    if (frame) UpdateFrameTexture(frame);
 
     SDL_SetRenderDrawColor(renderer, 0xff, 0xff, 0xff, 0xff);
     SDL_RenderClear(renderer);
@@ -65,12 +54,56 @@ void SdlRenderer::Draw(bool forceRedraw) {
                          .y = 0,
                          .w = scale * displayConfiguration.width,
                          .h = scale * displayConfiguration.height};
-        SDL_RenderCopy(renderer, frameTexture, nullptr, &dest);
+        SDL_RenderCopy(renderer,
+                       frameFormat == frameFormatRgb565 ? frameTextureRgb565 : frameTexture,
+                       nullptr, &dest);
     }
 
     SDL_RenderPresent(renderer);
+}
 
-    socResetPendingFrame(soc);
+void SdlRenderer::UpdateFrameTexture(const Frame* frame) {
+    const FrameFormat format = frame->format;
+    const int width = displayConfiguration.width;
+    const uint32_t* data = frame->data.get();
+
+    uint32_t nSpans = frame->nDamageSpans;
+    const FrameDamageSpan* spans = frame->damageSpans.get();
+
+    // the damage is relative to the previous frame, which is useless after a format change
+    const FrameDamageSpan fullFrame = {.firstRow = 0,
+                                       .nRows = (uint16_t)displayConfiguration.height};
+    if (!frameTextureValid || frame->fullUpdate || format != frameFormat) {
+        spans = &fullFrame;
+        nSpans = 1;
+    }
+
+    frameTextureValid = true;
+    frameFormat = format;
+
+    for (uint32_t i = 0; i < nSpans; i++) {
+        const uint32_t firstPixel = spans[i].firstRow * width;
+        SDL_Rect rect = {.x = 0, .y = spans[i].firstRow, .w = width, .h = spans[i].nRows};
+
+        switch (format) {
+            case frameFormatRgb565:
+                SDL_UpdateTexture(frameTextureRgb565, &rect,
+                                  reinterpret_cast<const uint16_t*>(data) + firstPixel,
+                                  2 * width);
+                break;
+
+            case frameFormatIndexed8:
+                lcdConvert(indexedFrameBuffer.get(),
+                           reinterpret_cast<const uint8_t*>(data) + firstPixel,
+                           spans[i].nRows * width, 3, frame->palette, nullptr);
+                SDL_UpdateTexture(frameTexture, &rect, indexedFrameBuffer.get(), 4 * width);
+                break;
+
+            default:
+                SDL_UpdateTexture(frameTexture, &rect, data + firstPixel, 4 * width);
+                break;
+        }
+    }
 }
 
 void SdlRenderer::DrawSilkscreen() {
@@ -3,28 +3,34 @@
 
 #include <SDL.h>
 
+#include <memory>
+
+#include "FrameExchange.h"
 #include "SoC.h"
 #include "device.h"
 
 class SdlRenderer {
    public:
-    SdlRenderer(SDL_Window* window, SDL_Renderer* renderer, SoC* soc, int scale);
+    SdlRenderer(SDL_Window* window, SDL_Renderer* renderer, int scale);
 
-    void Draw(bool forceRedraw);
+    void Draw(const Frame* frame, bool forceRedraw);
 
    private:
     void DrawSilkscreen();
+    void UpdateFrameTexture(const Frame* frame);
 
    private:
     SDL_Window* window{nullptr};
     SDL_Renderer* renderer{nullptr};
 
     SDL_Texture* frameTexture{nullptr};
+    SDL_Texture* frameTextureRgb565{nullptr};
     SDL_Texture* silkscreenTexture{nullptr};
 
     bool frameTextureValid{false};
+    FrameFormat frameFormat{frameFormatAbgr8888};
 
-    SoC* soc{nullptr};
+    std::unique_ptr<uint32_t[]> indexedFrameBuffer;
 
     const int scale;
     DeviceDisplayConfiguration displayConfiguration;
@@ -26,7 +26,10 @@
     #include <SDL_image.h>
 
     #include <atomic>
+    #include <thread>
 
+    #include "FrameExchange.h"
+    #include "FrameStreamWriter.h"
     #include "SdlAudioDriver.h"
     #include "SdlEventHandler.h"
     #include "SdlRenderer.h"
@@ -53,19 +56,64 @@ namespace {
     constexpr size_t AUDIO_QUEUE_SIZE = 44100 / MAIN_LOOP_FPS * 10;
 
     SoC* soc = nullptr;
+    const char* romDecodeCache = nullptr;
+    const char* syscallProfile = nullptr;
+    const char* pcSamples = nullptr;
+    const char* symbolMap = nullptr;
+    const char* frameStream = nullptr;
+
+    constexpr uint32_t PC_SAMPLING_RATE_HZ = 1000;
+
+#ifndef __EMSCRIPTEN__
+    constexpr size_t INPUT_QUEUE_SIZE = 256;
+    constexpr uint32_t RENDER_POLL_USEC = 1000000 / (2 * MAIN_LOOP_FPS);
+#endif
 
     AudioQueue* audioQueue = nullptr;
     unique_ptr<MainLoop> mainLoop;
 
+#ifndef __EMSCRIPTEN__
+    atomic<bool> terminationRequested{false};
+#endif
+
     void usage(const char* self) {
         fprintf(stderr,
                 "USAGE: %s {-r ROMFILE.bin | -x} [-g gdbPort] [-s SDCARD_IMG.bin] [-n NAND.bin] "
-                "[-q] [-m mips]\n",
+                "[-q] [-m mips] [-c DECODE_CACHE.bin] [-p PROFILE{.txt|.csv}] "
+                "[-f SAMPLES.folded [-y SYMBOLS.map]] [-o {FILE | fd:N | unix:SOCKET}]\n",
                 self);
 
         exit(-1);
     }
 
+    void writeSyscallProfile() {
+        if (!soc || !syscallProfile) return;
+
+        FILE* file = fopen(syscallProfile, "w");
+        if (!file) {
+            fprintf(stderr, "unable to open %s\n", syscallProfile);
+            return;
+        }
+
+        const size_t len = strlen(syscallProfile);
+        socDumpSyscallProfile(soc, file, len >= 4 && strcmp(syscallProfile + len - 4, ".csv") == 0);
+
+        fclose(file);
+    }
+
+    void writePcSamples() {
+        if (!soc || !pcSamples) return;
+
+        FILE* file = fopen(pcSamples, "w");
+        if (!file) {
+            fprintf(stderr, "unable to open %s\n", pcSamples);
+            return;
+        }
+
+        socWritePcSamples(soc, file);
+        fclose(file);
+    }
+
     void readSdCard(const char* fname) {
         FILE* cardFile = fopen(fname, "r+b");
 
@@ -96,6 +144,78 @@ namespace {
     }
 
 #ifndef __EMSCRIPTEN__
+    // Runs the emulation until stop is set. Frames go out through the frame exchange, input
+    // comes in through the input queue, so SDL stays on the main thread.
+    void runEmulation(FrameExchange& frameExchange, SpscQueue<InputEvent>& inputQueue,
+                      SdlAudioDriver* audioDriver, const atomic<bool>& stop) {
+        uint64_t lastSpeedDump = timestampUsec();
+        InputEvent event;
+
+        while (!stop.load(memory_order_relaxed)) {
+            uint64_t now = timestampUsec();
+
+            while (inputQueue.Pop(event)) SdlEventHandler::Dispatch(soc, event);
+
+            if (audioDriver) socSetPcmSuspended(soc, audioDriver->GetAudioBackpressure());
+
+            mainLoop->Cycle(now);
+
+            frameExchange.Publish(soc);
+
+            if (now - lastSpeedDump > 1000000) {
+                const uint64_t currentIps = mainLoop->GetCurrentIps();
+                const uint64_t currentIpsMax = mainLoop->GetCurrentIpsMax();
+                lastSpeedDump = now;
+
+                cout << "current speed: " << currentIps
+                     << " IPS, theoretical speed: " << currentIpsMax << " IPS -> "
+                     << (100 * currentIps) / currentIpsMax << "%" << endl
+                     << flush;
+            }
+
+            const int64_t timesliceRemaining =
+                mainLoop->GetTimesliceSizeUsec() - static_cast<int64_t>(timestampUsec() - now);
+
+            if (timesliceRemaining > 10) usleep(timesliceRemaining);
+        }
+    }
+
+    void requestTermination(int signal) { terminationRequested = true; }
+
+    // Headless mode: no SDL, frames are encoded to the frame stream on a separate thread. Runs
+    // until SIGINT / SIGTERM or until the stream is closed by the reader.
+    void runHeadless(const DeviceDisplayConfiguration& displayConfiguration) {
+        const int fd = FrameStreamWriter::OpenTarget(frameStream);
+        if (fd < 0) exit(1);
+
+        signal(SIGPIPE, SIG_IGN);
+        signal(SIGINT, requestTermination);
+        signal(SIGTERM, requestTermination);
+
+        FrameExchange frameExchange(displayConfiguration.width, displayConfiguration.height);
+        socSetNativeFrameFormat(soc, true);
+
+        FrameStreamWriter writer(frameExchange, fd, displayConfiguration.width,
+                                 displayConfiguration.height);
+        writer.Start();
+
+        SpscQueue<InputEvent> inputQueue(INPUT_QUEUE_SIZE);
+        atomic<bool> stopEmulation{false};
+        thread emulationThread(runEmulation, ref(frameExchange), ref(inputQueue), nullptr,
+                               cref(stopEmulation));
+
+        while (!terminationRequested && writer.IsStreaming()) usleep(RENDER_POLL_USEC);
+
+        const bool streamFailed = !writer.IsStreaming();
+
+        stopEmulation = true;
+        emulationThread.join();
+        writer.Stop();
+
+        // profiles are written by the exit handlers
+        exit(streamFailed ? 1 : 0);
+    }
+
     void initSdl(struct DeviceDisplayConfiguration displayConfiguration, int scale,
                  SDL_Window** window, SDL_Renderer** renderer, bool enableAudio) {
         if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS | (enableAudio ? SDL_INIT_AUDIO : 0)) < 0) {
@@ -167,6 +287,40 @@ void* EMSCRIPTEN_KEEPALIVE getFrame() {
     return socGetPendingFrame(soc);
 }
 
+// Damaged rows of the pending frame as pairs of 16 bit (first row, row count)
+void* EMSCRIPTEN_KEEPALIVE getFrameDamage() {
+    if (!soc) return nullptr;
+
+    uint32_t nSpans;
+    return (void*)socGetPendingFrameDamage(soc, &nSpans);
+}
+
+uint32_t EMSCRIPTEN_KEEPALIVE getFrameDamageSpanCount() {
+    if (!soc) return 0;
+
+    uint32_t nSpans;
+    socGetPendingFrameDamage(soc, &nSpans);
+
+    return nSpans;
+}
+
+// 0: ABGR8888, 1: RGB565, 2: 8 bit indices into getFramePalette
+uint32_t EMSCRIPTEN_KEEPALIVE getFrameFormat() {
+    return soc ? socGetPendingFrameFormat(soc) : frameFormatAbgr8888;
+}
+
+void* EMSCRIPTEN_KEEPALIVE getFramePalette() {
+    return soc ? (void*)socGetPendingFramePalette(soc) : nullptr;
+}
+
+void EMSCRIPTEN_KEEPALIVE setNativeFrameFormat(bool enable) {
+    if (soc) socSetNativeFrameFormat(soc, enable);
+}
+
+void EMSCRIPTEN_KEEPALIVE setLcdRefreshRate(uint32_t refreshHz, uint32_t captureHz) {
+    if (soc) socSetLcdRefreshRate(soc, refreshHz, captureHz);
+}
+
 void EMSCRIPTEN_KEEPALIVE resetFrame() {
     if (!soc) return;
 
@@ -205,6 +359,14 @@ void EMSCRIPTEN_KEEPALIVE setCyclesPerSecondLimit(unsigned int cyclesPerSecondLi
 
 uint64_t EMSCRIPTEN_KEEPALIVE getTimestampUsec() { return timestampUsec(); }
 
+void EMSCRIPTEN_KEEPALIVE setSyscallProfiling(bool enable) {
+    if (soc) socSetSyscallProfiling(soc, enable);
+}
+
+void EMSCRIPTEN_KEEPALIVE dumpSyscallProfile(bool csv) {
+    if (soc) socDumpSyscallProfile(soc, stderr, csv);
+}
+
 void EMSCRIPTEN_KEEPALIVE keyDown(int key) {
     if (!soc) return;
 
@@ -266,6 +428,18 @@ void run(uint8_t* rom, uint32_t romLen, uint8_t* nand, size_t nandLen, int gdbPo
     soc = socInit(rom, romLen, sdCardSectorCount(), sdCardRead, sdCardWrite, nand, nandLen, gdbPort,
                   deviceGetSocRev());
 
+    if (romDecodeCache) socPredecodeRom(soc, romDecodeCache);
+
+    if (syscallProfile) {
+        socSetSyscallProfiling(soc, true);
+        atexit(writeSyscallProfile);
+    }
+
+    if (pcSamples) {
+        if (!socStartPcSampling(soc, PC_SAMPLING_RATE_HZ, symbolMap)) exit(1);
+        atexit(writePcSamples);
+    }
+
     audioQueue = audioQueueCreate(AUDIO_QUEUE_SIZE);
     socSetAudioQueue(soc, audioQueue);
 
@@ -278,6 +452,8 @@ void run(uint8_t* rom, uint32_t romLen, uint8_t* nand, size_t nandLen, int gdbPo
     DeviceDisplayConfiguration displayConfiguration;
     deviceGetDisplayConfiguration(&displayConfiguration);
 
+    if (frameStream) return runHeadless(displayConfiguration);
+
     SDL_Window* window;
     SDL_Renderer* renderer;
 
@@ -285,8 +461,14 @@ void run(uint8_t* rom, uint32_t romLen, uint8_t* nand, size_t nandLen, int gdbPo
 
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xff);
     SDL_RenderClear(renderer);
-    SdlRenderer sdlRenderer(window, renderer, soc, SCALE);
-    SdlEventHandler sdlEventHandler(soc, SCALE);
+    SdlRenderer sdlRenderer(window, renderer, SCALE);
+
+    SpscQueue<InputEvent> inputQueue(INPUT_QUEUE_SIZE);
+    SdlEventHandler sdlEventHandler(inputQueue, SCALE);
+
+    FrameExchange frameExchange(displayConfiguration.width, displayConfiguration.height);
+    socSetNativeFrameFormat(soc, true);
+
     unique_ptr<SdlAudioDriver> audioDriver;
 
     if (enableAudio) {
@@ -294,35 +476,23 @@ void run(uint8_t* rom, uint32_t romLen, uint8_t* nand, size_t nandLen, int gdbPo
         audioDriver->Start();
     }
 
-    uint64_t lastSpeedDump = timestampUsec();
-
-    while (true) {
-        uint64_t now = timestampUsec();
-
-        if (audioDriver) socSetPcmSuspended(soc, audioDriver->GetAudioBackpressure());
-
-        mainLoop->Cycle(now);
-
-        sdlRenderer.Draw(sdlEventHandler.RedrawRequested());
-        sdlEventHandler.ClearRedrawRequested();
+    atomic<bool> stopEmulation{false};
+    thread emulationThread(runEmulation, ref(frameExchange), ref(inputQueue), audioDriver.get(),
+                           cref(stopEmulation));
 
+    while (!sdlEventHandler.QuitRequested()) {
         sdlEventHandler.HandleEvents();
 
-        if (now - lastSpeedDump > 1000000) {
-            const uint64_t currentIps = mainLoop->GetCurrentIps();
-            const uint64_t currentIpsMax = mainLoop->GetCurrentIpsMax();
-            lastSpeedDump = now;
+        sdlRenderer.Draw(frameExchange.Acquire(), sdlEventHandler.RedrawRequested());
+        sdlEventHandler.ClearRedrawRequested();
 
-            cout << "current speed: " << currentIps << " IPS, theoretical speed: " << currentIpsMax
-                 << " IPS -> " << (100 * currentIps) / currentIpsMax << "%" << endl
-                 << flush;
-        }
+        usleep(RENDER_POLL_USEC);
+    }
 
-        const int64_t timesliceRemaining =
-            mainLoop->GetTimesliceSizeUsec() - static_cast<int64_t>(timestampUsec() - now);
+    stopEmulation = true;
+    emulationThread.join();
 
-        if (timesliceRemaining > 10) usleep(timesliceRemaining);
-    }
+    exit(0);
 #endif
 }
 
@@ -341,7 +511,7 @@ int main(int argc, char** argv) {
     int c;
     uint32_t mips = 0;
 
-    while ((c = getopt(argc, argv, "g:s:r:n:m:xq")) != -1) switch (c) {
+    while ((c = getopt(argc, argv, "g:s:r:n:m:c:p:f:y:o:xq")) != -1) switch (c) {
             case 'g':  // gdb port
                 gdbPort = optarg ? atoi(optarg) : -1;
                 if (gdbPort < 1024 || gdbPort > 65535) usage(self);
@@ -367,6 +537,27 @@ int main(int argc, char** argv) {
                 enableAudio = false;
                 break;
 
+            case 'c':  // ROM decode cache
+                romDecodeCache = optarg;
+                break;
+
+            case 'p':  // syscall profile
+                syscallProfile = optarg;
+                break;
+
+            case 'f':  // PC samples
+                pcSamples = optarg;
+                break;
+
+            case 'y':  // symbol map for PC samples
+                symbolMap = optarg;
+                break;
+
+            case 'o':  // headless frame stream
+                frameStream = optarg;
+                enableAudio = false;
+                break;
+
             case 'm':
                 mips = atoi(optarg);
                 if (mips < 50 || mips > 500) {
@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "../uarm/ac97dev_WM9712L.h"
+#include "../uarm/audio_queue.h"
+#include "../uarm/pxa_DMA.h"
+#include "../uarm/soc_AC97.h"
+
+// Runs the WM9712L codec against the PXA AC97 controller. The DMA controller is replaced by a
+// model that moves an 8 word burst into the TX FIFO on each 102.4 kHz DMA tick while the FIFO
+// requests data, which is what pxa_DMA does for the AC97 channel.
+
+namespace {
+    constexpr uint32_t AC97_BASE = 0x40500000;
+    constexpr uint32_t AC97_POSR = AC97_BASE + 0x10;
+    constexpr uint32_t AC97_PCDR = AC97_BASE + 0x40;
+    constexpr uint32_t AC97_PRIMARY_CODEC = AC97_BASE + 0x200;
+
+    constexpr uint16_t CODEC_EXTDAUDIOCTL = 0x2a;
+    constexpr uint16_t CODEC_DACRATE = 0x2c;
+
+    constexpr uint32_t POSR_FIFO_ERROR = 0x10;
+
+    constexpr uint64_t DMA_HZ = 102400;
+    constexpr uint64_t FRAME_HZ = 48000;
+    constexpr uint32_t BLOCK_FRAMES = 8;
+    constexpr uint32_t BURST_WORDS = 8;
+
+    // a quarter second keeps the 16 bit ramp below in range
+    constexpr uint32_t BLOCKS = FRAME_HZ / BLOCK_FRAMES / 4;
+
+    ArmMemAccessF ac97Access = nullptr;
+    void* ac97UserData = nullptr;
+
+    bool txRequested = false;
+    std::vector<uint32_t> output;
+
+    class Playback {
+       public:
+        Playback() {
+            txRequested = false;
+            output.clear();
+
+            ac97 = socAC97Init(nullptr, nullptr, nullptr);
+            wm = wm9712LInit(ac97, nullptr, -1);
+
+            wm9712LsetAudioQueue(wm, reinterpret_cast<AudioQueue*>(&audioQueueDummy));
+        }
+
+        ~Playback() {
+            free(wm);
+            free(ac97);
+        }
+
+        void SetVariableRate(uint16_t rate) {
+            WriteCodec(CODEC_EXTDAUDIOCTL, 0x0411);
+            WriteCodec(CODEC_DACRATE, rate);
+        }
+
+        // The guest writes a ramp, so any sample that is lost or made up shows in the output
+        void Run(uint32_t nBlocks, uint32_t outputHz, bool dma = true) {
+            // the FIFO starts out empty and requests data
+            txRequested = true;
+
+            for (uint64_t block = 0; block < nBlocks; block++) {
+                for (; dmaTicks * FRAME_HZ <= block * BLOCK_FRAMES * DMA_HZ; dmaTicks++)
+                    if (dma && txRequested) Burst();
+
+                wm9712Lperiodic(wm, BLOCK_FRAMES, outputHz);
+            }
+        }
+
+        bool Underrun() {
+            uint32_t posr;
+            EXPECT_TRUE(ac97Access(ac97UserData, AC97_POSR, 4, false, &posr));
+
+            return posr & POSR_FIFO_ERROR;
+        }
+
+       private:
+        void WriteCodec(uint16_t reg, uint16_t value) {
+            uint32_t word = value;
+            ASSERT_TRUE(ac97Access(ac97UserData, AC97_PRIMARY_CODEC + reg * 2, 4, true, &word));
+        }
+
+        void Burst() {
+            for (uint32_t i = 0; i < BURST_WORDS; i++) {
+                uint32_t sample = nextSample | (nextSample << 16);
+                nextSample++;
+
+                ASSERT_TRUE(ac97Access(ac97UserData, AC97_PCDR, 4, true, &sample));
+            }
+        }
+
+       private:
+        SocAC97* ac97;
+        WM9712L* wm;
+
+        uint64_t dmaTicks{0};
+        uint32_t nextSample{0};
+
+        int audioQueueDummy{0};
+    };
+
+    void expectRamp(uint32_t expectedSamples) {
+        EXPECT_NEAR(output.size(), expectedSamples, 2);
+
+        for (size_t i = 1; i < output.size(); i++) {
+            ASSERT_GE(output[i] & 0xffff, output[i - 1] & 0xffff) << i;
+            ASSERT_EQ(output[i] & 0xffff, output[i] >> 16) << i;
+        }
+    }
+}  // namespace
+
+extern "C" {
+bool memRegionAdd(struct ArmMem* mem, uint32_t pa, uint32_t sz, ArmMemAccessF af, void* uD) {
+    ac97Access = af;
+    ac97UserData = uD;
+
+    return true;
+}
+
+void socDmaExternalReq(struct SocDma* dma, uint_fast8_t chNum, bool requested) {
+    if (chNum == DMA_CMR_AC97_AUDIO_TX) txRequested = requested;
+}
+
+void socIcInt(struct SocIc* ic, uint_fast8_t intNum, bool raise) {}
+
+void socGpioSetState(struct SocGpio* gpio, uint_fast8_t gpioNum, bool on) {}
+
+size_t audioQueuePushChunk(struct AudioQueue* audioQueue, const uint32_t* samples, size_t count) {
+    output.insert(output.end(), samples, samples + count);
+
+    return count;
+}
+
+void uarmAbort() { abort(); }
+}
+
+TEST(Ac97Playback, NoUnderrunsAt48kHz) {
+    Playback playback;
+    playback.Run(BLOCKS, 44100);
+
+    EXPECT_FALSE(playback.Underrun());
+    expectRamp(BLOCKS * BLOCK_FRAMES * 44100 / FRAME_HZ);
+}
+
+TEST(Ac97Playback, NoUnderrunsWithPcmOutputDisabled) {
+    Playback playback;
+    playback.Run(BLOCKS, 44100 / 3);
+
+    EXPECT_FALSE(playback.Underrun());
+    expectRamp(BLOCKS * BLOCK_FRAMES * (44100 / 3) / FRAME_HZ);
+}
+
+TEST(Ac97Playback, NoUnderrunsAtVariableRates) {
+    for (uint16_t rate : {8000, 11025, 16000, 22050, 32000, 44100, 48000}) {
+        SCOPED_TRACE(rate);
+
+        Playback playback;
+        playback.SetVariableRate(rate);
+        playback.Run(BLOCKS, 44100);
+
+        EXPECT_FALSE(playback.Underrun());
+        expectRamp(BLOCKS * BLOCK_FRAMES * 44100 / FRAME_HZ);
+    }
+}
+
+TEST(Ac97Playback, UnderrunsDoNotMakeUpSamples) {
+    Playback playback;
+    playback.Run(BLOCKS, 44100, false);
+
+    EXPECT_TRUE(playback.Underrun());
+    EXPECT_TRUE(output.empty());
+}
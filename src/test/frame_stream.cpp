@@ -0,0 +1,242 @@
+#include "../FrameStreamEncoder.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+    constexpr uint32_t WIDTH = 8;
+    constexpr uint32_t HEIGHT = 6;
+
+    class Reader {
+       public:
+        Reader(const std::vector<uint8_t>& data) : data(data) {}
+
+        uint8_t Get8() { return data.at(position++); }
+
+        uint16_t Get16() {
+            const uint16_t low = Get8();
+            return low | (Get8() << 8);
+        }
+
+        uint32_t Get32() {
+            const uint32_t low = Get16();
+            return low | (Get16() << 16);
+        }
+
+        void Get(uint8_t* destination, size_t size) {
+            for (size_t i = 0; i < size; i++) destination[i] = Get8();
+        }
+
+        size_t GetPosition() const { return position; }
+        bool AtEnd() const { return position == data.size(); }
+
+       private:
+        const std::vector<uint8_t>& data;
+        size_t position{0};
+    };
+
+    // Decodes RLE data into little endian pixels
+    void decodeRle(Reader& reader, uint8_t* pixels, uint32_t nPixels, uint32_t bytesPerPixel) {
+        uint32_t i = 0;
+
+        while (i < nPixels) {
+            const uint8_t header = reader.Get8();
+
+            if (header & 0x80) {
+                uint8_t pixel[4];
+                reader.Get(pixel, bytesPerPixel);
+
+                for (uint32_t j = 0; j <= (header & 0x7fu); j++, i++)
+                    memcpy(pixels + i * bytesPerPixel, pixel, bytesPerPixel);
+            } else {
+                reader.Get(pixels + i * bytesPerPixel, (header + 1) * bytesPerPixel);
+                i += header + 1;
+            }
+        }
+
+        ASSERT_EQ(i, nPixels);
+    }
+
+    uint32_t bytesPerPixel(uint8_t format) {
+        return format == frameFormatRgb565 ? 2 : (format == frameFormatIndexed8 ? 1 : 4);
+    }
+
+    class Decoder {
+       public:
+        void DecodeHeader(const std::vector<uint8_t>& data) {
+            Reader reader(data);
+
+            uint8_t magic[8];
+            reader.Get(magic, 8);
+            EXPECT_EQ(memcmp(magic, "UARMFRM1", 8), 0);
+
+            EXPECT_EQ(reader.Get16(), WIDTH);
+            EXPECT_EQ(reader.Get16(), HEIGHT);
+            EXPECT_TRUE(reader.AtEnd());
+        }
+
+        void DecodeFrame(const std::vector<uint8_t>& data) {
+            Reader reader(data);
+
+            EXPECT_EQ(reader.Get32(), data.size() - 4);
+
+            format = reader.Get8();
+            flags = reader.Get8();
+            nSpans = reader.Get16();
+            frameNumber = reader.Get32();
+
+            if (flags & FrameStreamEncoder::FRAME_STREAM_FLAG_PALETTE)
+                for (uint32_t i = 0; i < 256; i++) palette[i] = reader.Get32();
+
+            const uint32_t pixelSize = bytesPerPixel(format);
+
+            for (uint32_t i = 0; i < nSpans; i++) {
+                const uint16_t firstRow = reader.Get16();
+                const uint16_t nRows = reader.Get16();
+                const uint32_t length = reader.Get32();
+                const size_t start = reader.GetPosition();
+
+                ASSERT_LE(firstRow + nRows, HEIGHT);
+
+                decodeRle(reader, pixels + firstRow * WIDTH * pixelSize, nRows * WIDTH,
+                          pixelSize);
+                EXPECT_EQ(reader.GetPosition() - start, length);
+            }
+
+            EXPECT_TRUE(reader.AtEnd());
+        }
+
+       public:
+        uint8_t format{0};
+        uint8_t flags{0};
+        uint16_t nSpans{0};
+        uint32_t frameNumber{0};
+        uint32_t palette[256] = {};
+
+        uint8_t pixels[WIDTH * HEIGHT * 4] = {};
+    };
+
+    void initFrame(Frame& frame, FrameFormat format) {
+        frame.format = format;
+        frame.data = std::make_unique<uint32_t[]>(WIDTH * HEIGHT);
+        frame.damageSpans = std::make_unique<FrameDamageSpan[]>(HEIGHT);
+        frame.fullUpdate = false;
+
+        memset(frame.data.get(), 0, WIDTH * HEIGHT * 4);
+        memset(frame.palette, 0, sizeof(frame.palette));
+    }
+
+    std::vector<uint8_t> roundTripRle(const std::vector<uint8_t>& pixels,
+                                      uint32_t bytesPerPixel) {
+        std::vector<uint8_t> encoded;
+        const uint32_t nPixels = pixels.size() / bytesPerPixel;
+
+        FrameStreamEncoder::EncodeRle(encoded, pixels.data(), nPixels, bytesPerPixel);
+
+        std::vector<uint8_t> decoded(pixels.size());
+        Reader reader(encoded);
+
+        decodeRle(reader, decoded.data(), nPixels, bytesPerPixel);
+        EXPECT_TRUE(reader.AtEnd());
+
+        return decoded;
+    }
+}  // namespace
+
+TEST(FrameStream, RleRoundTrips) {
+    for (uint32_t bytesPerPixel : {1u, 2u, 4u}) {
+        std::vector<uint8_t> pixels;
+
+        auto push = [&](uint32_t value) {
+            for (uint32_t i = 0; i < bytesPerPixel; i++) pixels.push_back(value >> (8 * i));
+        };
+
+        // long runs, long literal stretches, runs of two and single pixels
+        for (int i = 0; i < 300; i++) push(0x11223344);
+        for (int i = 0; i < 300; i++) push(i * 7);
+        for (int i = 0; i < 10; i++) push(i / 2);
+        push(0x55);
+
+        EXPECT_EQ(roundTripRle(pixels, bytesPerPixel), pixels) << bytesPerPixel;
+    }
+}
+
+TEST(FrameStream, RlePixelsAreLittleEndian) {
+    const uint16_t pixels[] = {0x1234, 0x5678, 0x5678};
+    std::vector<uint8_t> encoded;
+
+    FrameStreamEncoder::EncodeRle(encoded, reinterpret_cast<const uint8_t*>(pixels), 3, 2);
+
+    const std::vector<uint8_t> expected = {0x00, 0x34, 0x12, 0x81, 0x78, 0x56};
+    EXPECT_EQ(encoded, expected);
+}
+
+TEST(FrameStream, KeyframeAndDeltaFrameRoundTrip) {
+    FrameStreamEncoder encoder(WIDTH, HEIGHT);
+    Decoder decoder;
+
+    decoder.DecodeHeader(encoder.EncodeHeader());
+
+    Frame frame;
+    initFrame(frame, frameFormatRgb565);
+
+    uint16_t* pixels = reinterpret_cast<uint16_t*>(frame.data.get());
+    for (uint32_t i = 0; i < WIDTH * HEIGHT; i++) pixels[i] = i < 20 ? 0xf800 : i;
+
+    // the first frame is a keyframe even without damage
+    decoder.DecodeFrame(encoder.EncodeFrame(frame));
+
+    EXPECT_EQ(decoder.format, frameFormatRgb565);
+    EXPECT_EQ(decoder.flags, FrameStreamEncoder::FRAME_STREAM_FLAG_KEYFRAME);
+    EXPECT_EQ(decoder.nSpans, 1);
+    EXPECT_EQ(decoder.frameNumber, static_cast<uint32_t>(0));
+    EXPECT_EQ(memcmp(decoder.pixels, pixels, WIDTH * HEIGHT * 2), 0);
+
+    for (uint32_t i = 2 * WIDTH; i < 4 * WIDTH; i++) pixels[i] = 0x07e0;
+    frame.damageSpans[0] = {.firstRow = 2, .nRows = 2};
+    frame.nDamageSpans = 1;
+
+    decoder.DecodeFrame(encoder.EncodeFrame(frame));
+
+    EXPECT_EQ(decoder.flags, 0);
+    EXPECT_EQ(decoder.nSpans, 1);
+    EXPECT_EQ(decoder.frameNumber, static_cast<uint32_t>(1));
+    EXPECT_EQ(memcmp(decoder.pixels, pixels, WIDTH * HEIGHT * 2), 0);
+}
+
+TEST(FrameStream, PaletteIsSentWhenItChanges) {
+    FrameStreamEncoder encoder(WIDTH, HEIGHT);
+    Decoder decoder;
+
+    decoder.DecodeHeader(encoder.EncodeHeader());
+
+    Frame frame;
+    initFrame(frame, frameFormatIndexed8);
+
+    uint8_t* pixels = reinterpret_cast<uint8_t*>(frame.data.get());
+    for (uint32_t i = 0; i < WIDTH * HEIGHT; i++) pixels[i] = i % 3;
+    for (uint32_t i = 0; i < 256; i++) frame.palette[i] = 0xff000000 | i;
+
+    decoder.DecodeFrame(encoder.EncodeFrame(frame));
+
+    EXPECT_EQ(decoder.flags, FrameStreamEncoder::FRAME_STREAM_FLAG_KEYFRAME |
+                                 FrameStreamEncoder::FRAME_STREAM_FLAG_PALETTE);
+    EXPECT_EQ(memcmp(decoder.palette, frame.palette, sizeof(frame.palette)), 0);
+    EXPECT_EQ(memcmp(decoder.pixels, pixels, WIDTH * HEIGHT), 0);
+
+    // no damage, same palette
+    decoder.DecodeFrame(encoder.EncodeFrame(frame));
+
+    EXPECT_EQ(decoder.flags, 0);
+    EXPECT_EQ(decoder.nSpans, 0);
+
+    frame.palette[1] = 0xff00ff00;
+    decoder.DecodeFrame(encoder.EncodeFrame(frame));
+
+    EXPECT_EQ(decoder.flags, FrameStreamEncoder::FRAME_STREAM_FLAG_PALETTE);
+    EXPECT_EQ(memcmp(decoder.palette, frame.palette, sizeof(frame.palette)), 0);
+}
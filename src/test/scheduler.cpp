@@ -471,4 +471,21 @@ namespace {
         dispatchDelegate.ExpectInvocation(4, SCHEDULER_TASK_TIMER, 1);
     }
 
+    TEST(Scheduler, PendingTicksAreRoundedUp) {
+        DispatchDelegate dispatchDelegate;
+        Scheduler<DispatchDelegate> scheduler(dispatchDelegate);
+
+        scheduler.ScheduleTask(SCHEDULER_TASK_TIMER, 10_usec, 5);
+        EXPECT_EQ(scheduler.GetPendingTicks(SCHEDULER_TASK_TIMER), static_cast<uint32_t>(5));
+
+        scheduler.Advance(23, 1_mhz);
+        EXPECT_EQ(scheduler.GetPendingTicks(SCHEDULER_TASK_TIMER), static_cast<uint32_t>(3));
+
+        scheduler.Advance(7, 1_mhz);
+        EXPECT_EQ(scheduler.GetPendingTicks(SCHEDULER_TASK_TIMER), static_cast<uint32_t>(2));
+
+        scheduler.UnscheduleTask(SCHEDULER_TASK_TIMER);
+        EXPECT_EQ(scheduler.GetPendingTicks(SCHEDULER_TASK_TIMER), static_cast<uint32_t>(0));
+    }
+
 }  // namespace
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "../uarm/spsc_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+
+TEST(SpscQueue, CapacityIsRoundedToPowerOfTwo) {
+    SpscQueue<int> queue(5);
+
+    EXPECT_EQ(queue.GetCapacity(), static_cast<size_t>(8));
+    EXPECT_EQ(queue.GetSize(), static_cast<size_t>(0));
+}
+
+TEST(SpscQueue, QueueIsFifo) {
+    SpscQueue<int> queue(4);
+    int item;
+
+    EXPECT_TRUE(queue.Push(1));
+    EXPECT_TRUE(queue.Push(2));
+    EXPECT_EQ(queue.GetSize(), static_cast<size_t>(2));
+
+    EXPECT_TRUE(queue.Pop(item));
+    EXPECT_EQ(item, 1);
+
+    EXPECT_TRUE(queue.Pop(item));
+    EXPECT_EQ(item, 2);
+
+    EXPECT_FALSE(queue.Pop(item));
+}
+
+TEST(SpscQueue, PushFailsWhenFull) {
+    SpscQueue<int> queue(2);
+    int item;
+
+    EXPECT_TRUE(queue.Push(1));
+    EXPECT_TRUE(queue.Push(2));
+    EXPECT_FALSE(queue.Push(3));
+
+    EXPECT_TRUE(queue.Pop(item));
+    EXPECT_TRUE(queue.Push(3));
+
+    EXPECT_TRUE(queue.Pop(item));
+    EXPECT_EQ(item, 2);
+
+    EXPECT_TRUE(queue.Pop(item));
+    EXPECT_EQ(item, 3);
+}
+
+TEST(SpscQueue, TransfersAcrossThreadsInOrder) {
+    constexpr int COUNT = 100000;
+    SpscQueue<int> queue(16);
+
+    std::thread producer([&]() {
+        for (int i = 0; i < COUNT; i++)
+            while (!queue.Push(i)) std::this_thread::yield();
+    });
+
+    int item;
+    for (int i = 0; i < COUNT; i++) {
+        while (!queue.Pop(item)) std::this_thread::yield();
+        ASSERT_EQ(item, i);
+    }
+
+    producer.join();
+}
+
+TEST(SpscQueue, PushNIsLimitedByFreeSpace) {
+    SpscQueue<int> queue(8);
+    const int items[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+
+    EXPECT_EQ(queue.PushN(items, 5), static_cast<size_t>(5));
+    EXPECT_EQ(queue.PushN(items + 5, 5), static_cast<size_t>(3));
+    EXPECT_EQ(queue.GetSize(), static_cast<size_t>(8));
+
+    int popped[10] = {};
+    EXPECT_EQ(queue.PopN(popped, 10), static_cast<size_t>(8));
+
+    for (int i = 0; i < 8; i++) EXPECT_EQ(popped[i], i + 1);
+}
+
+TEST(SpscQueue, BulkOperationsWrap) {
+    SpscQueue<int> queue(8);
+    const int items[] = {1, 2, 3, 4, 5, 6};
+    int popped[6] = {};
+
+    EXPECT_EQ(queue.PushN(items, 6), static_cast<size_t>(6));
+    EXPECT_EQ(queue.PopN(popped, 4), static_cast<size_t>(4));
+
+    // wraps around the end of the buffer on both sides
+    EXPECT_EQ(queue.PushN(items, 6), static_cast<size_t>(6));
+    EXPECT_EQ(queue.PopN(popped, 6), static_cast<size_t>(6));
+
+    const int expected[] = {5, 6, 1, 2, 3, 4};
+    for (int i = 0; i < 6; i++) EXPECT_EQ(popped[i], expected[i]);
+
+    EXPECT_EQ(queue.PopN(popped, 6), static_cast<size_t>(2));
+    EXPECT_EQ(popped[0], 5);
+    EXPECT_EQ(popped[1], 6);
+}
+
+TEST(SpscQueue, ClearDropsPendingItems) {
+    SpscQueue<int> queue(4);
+    int item;
+
+    queue.Push(1);
+    queue.Push(2);
+    queue.Clear();
+
+    EXPECT_EQ(queue.GetSize(), static_cast<size_t>(0));
+    EXPECT_FALSE(queue.Pop(item));
+
+    queue.Push(3);
+    EXPECT_TRUE(queue.Pop(item));
+    EXPECT_EQ(item, 3);
+}
+
+TEST(SpscQueue, DropUntilKeepsLaterItems) {
+    SpscQueue<int> queue(8);
+    int item;
+
+    queue.Push(1);
+    queue.Push(2);
+    const size_t pushIndex = queue.GetPushIndex();
+    queue.Push(3);
+
+    queue.DropUntil(pushIndex);
+    EXPECT_EQ(queue.GetSize(), static_cast<size_t>(1));
+
+    EXPECT_TRUE(queue.Pop(item));
+    EXPECT_EQ(item, 3);
+
+    // items that were already popped stay popped
+    queue.Push(4);
+    queue.DropUntil(pushIndex);
+    EXPECT_TRUE(queue.Pop(item));
+    EXPECT_EQ(item, 4);
+}
+
+TEST(SpscQueue, DropUntilPastStaleTail) {
+    SpscQueue<int> queue(16);
+    int items[8];
+
+    for (int i = 0; i < 4; i++) queue.Push(i);
+    EXPECT_EQ(queue.PopN(items, 1), static_cast<size_t>(1));
+
+    for (int i = 4; i < 10; i++) queue.Push(i);
+    queue.DropUntil(queue.GetPushIndex());
+
+    EXPECT_EQ(queue.GetSize(), static_cast<size_t>(0));
+    EXPECT_EQ(queue.PopN(items, 8), static_cast<size_t>(0));
+    EXPECT_FALSE(queue.Pop(items[0]));
+
+    queue.Push(10);
+    EXPECT_EQ(queue.PopN(items, 8), static_cast<size_t>(1));
+    EXPECT_EQ(items[0], 10);
+}
+
+TEST(SpscQueue, BulkTransfersAcrossThreadsInOrder) {
+    constexpr uint32_t COUNT = 200000;
+    SpscQueue<uint32_t> queue(64);
+
+    std::thread producer([&]() {
+        uint32_t chunk[23];
+        uint32_t next = 0;
+
+        while (next < COUNT) {
+            const uint32_t count = std::min<uint32_t>(23, COUNT - next);
+            for (uint32_t i = 0; i < count; i++) chunk[i] = next + i;
+
+            uint32_t pushed = 0;
+            while (pushed < count) {
+                pushed += queue.PushN(chunk + pushed, count - pushed);
+                if (pushed < count) std::this_thread::yield();
+            }
+
+            next += count;
+        }
+    });
+
+    uint32_t chunk[17];
+    uint32_t expected = 0;
+
+    while (expected < COUNT) {
+        const size_t count = queue.PopN(chunk, 17);
+        if (count == 0) std::this_thread::yield();
+
+        for (size_t i = 0; i < count; i++) ASSERT_EQ(chunk[i], expected++);
+    }
+
+    producer.join();
+}
@@ -10,12 +10,14 @@
 #include "../util.h"
 #include "MMU.h"
 #include "cp15.h"
+#include "cpu_tables.h"
 #include "gdbstub.h"
 #include "icache.h"
 #include "mem.h"
 #include "memcpy.h"
 #include "pace.h"
 #include "peephole.h"
+#include "pc_sampler.h"
 
 #define xstr(s) str(s)
 #define str(s) #s
@@ -134,26 +136,7 @@ struct ArmCpu {
     struct PatchDispatch *patchDispatch;
 };
 
-enum ImmShiftType {
-    shiftTypeNoop,
-    shiftTypeZero,
-    shiftTypeLSL,
-    shiftTypeLSR,
-    shiftTypeASR,
-    shiftTypeROR,
-    shiftTypeRRX,
-};
-
-struct ImmShift {
-    ImmShiftType type;
-    uint32_t coBit;
-    uint8_t shift;
-};
-
-static uint32_t *table_thumb2arm = NULL;
-static bool table_conditions[256];
-static ImmShift table_immShiftReg[1024];
-static ImmShift table_immShiftImm[128];
+static uint32_t *table_thumbDecoded = NULL;
 
 static FORCE_INLINE uint32_t cpuPrvClz(uint32_t val) {
     if (!val) return 32;
@@ -382,7 +365,7 @@ static FORCE_INLINE uint32_t cpuPrvArmAdrMode_1(struct ArmCpu *cpu, uint32_t ins
     uint_fast8_t v, a;
     bool co = cpu->flags & ARM_SR_C;  // be default carry out = C flag
     uint32_t ret;
-    struct ImmShift *shift;
+    const struct ImmShift *shift;
 
     if (instr & 0x02000000UL) {  // immed
 
@@ -395,11 +378,11 @@ static FORCE_INLINE uint32_t cpuPrvArmAdrMode_1(struct ArmCpu *cpu, uint32_t ins
 
         if (instr & 0x00000010UL) {
             a = cpuPrvGetRegNotPC(cpu, (instr >> 8) & 0x0F);
-            shift = table_immShiftReg + ((v << 8) | (a & 0xff));
+            shift = table_immShiftReg.data() + ((v << 8) | (a & 0xff));
 
         } else {
             a = (instr >> 7) & 0x1F;
-            shift = table_immShiftImm + ((v << 5) | a);
+            shift = table_immShiftImm.data() + ((v << 5) | a);
         }
 
         switch (shift->type) {  // perform shifts
@@ -1017,10 +1000,6 @@ static void execFn_peephole_ADC_memcpy(struct ArmCpu *cpu, uint32_t instr, bool
     uint32_t dest = cpuPrvGetRegNotPC(cpu, 0);
     uint32_t size = cpuPrvGetRegNotPC(cpu, 2);
 
-    // This should not be necessary, but it works around a bug where UDMH fails to
-    // invalidate the cache...
-    icacheInvalRange(cpu->ic, dest, size);
-
     MemcpyResult result;
     memcpy_armToArm(dest, src, size, privileged, cpu->mem, cpu->mmu, &result);
 
@@ -1802,12 +1781,13 @@ static void execFn_load_store_2(struct ArmCpu *cpu, uint32_t instr, bool privile
             // #define CALL_OSCALL(tab,num)	"LDR R12,[R9, #-" #tab "] \nLDR PC,[R12, #"
             // #num "]"
             if constexpr (mode & ARM_MODE_2_SYSCALL) {
-                if constexpr (destPc)
-                    // syscall && destPc -> sourceReg == 9 && destReg == 12
-                    patchDispatchOnLoadPcFromR12(cpu->patchDispatch, addBefore ? increment : 0,
-                                                 cpu->regs);
-                else
-                    // syscall && !destPc -> sourceReg == 12 && destReg == 15
+                if constexpr (destPc) {
+                    // syscall && destPc -> sourceReg == 12 && destReg == 15
+                    if (patchDispatchOnLoadPcFromR12(cpu->patchDispatch,
+                                                     addBefore ? increment : 0, cpu->regs))
+                        memVal32 = cpu->regs[REG_NO_LR];
+                } else
+                    // syscall && !destPc -> sourceReg == 9 && destReg == 12
                     patchDispatchOnLoadR12FromR9(cpu->patchDispatch, addBefore ? increment : 0);
             }
 
@@ -2693,13 +2673,27 @@ uint32_t cpuDecodeArm(uint32_t instr) {
     return cpuPrvCompressExecFn(cpuPrvDecoderArm<false>(instr));
 }
 
-uint32_t cpuDecodeThumb(uint32_t instr) {
+static uint32_t cpuPrvDecodeThumb(uint16_t instr) {
     const uint32_t translatedInstr = table_thumb2arm[instr];
 
     return cpuPrvCompressExecFn(translatedInstr ? cpuPrvDecoderArm<true>(translatedInstr)
                                                 : cpuPrvDecoderThumb(instr));
 }
 
+uint32_t cpuDecodeThumb(uint32_t instr) { return table_thumbDecoded[instr & 0xffff]; }
+
+uint64_t cpuGetDecoderId(void) {
+    // Compressed exec functions are only valid for the binary that produced them
+    uint64_t hash = fnv1a64(table_thumbDecoded, 0x10000 * sizeof(uint32_t), FNV1A64_INIT);
+
+    for (uint32_t instr = 0; instr < 0x10000; instr++) {
+        const uint32_t decoded = cpuDecodeArm((instr << 16) | instr);
+        hash = fnv1a64(&decoded, sizeof(decoded), hash);
+    }
+
+    return hash;
+}
+
 #ifdef __EMSCRIPTEN__
 
 // The content of this function will be replaced with a jump table later. We need two of
@@ -2785,410 +2779,6 @@ static void cpuPrvCycleThumb(struct ArmCpu *cpu) {
 #endif
 }
 
-static uint32_t translateThumb(uint16_t instrT) {
-    bool vB;
-    uint32_t instr = 0xE0000000UL /*most likely thing*/;
-    uint16_t v16;
-    uint_fast8_t v8;
-
-    switch (instrT >> 12) {
-        case 0:  // LSL(1) LSR(1) ASR(1) ADD(1) SUB(1) ADD(3) SUB(3)
-        case 1:
-            if ((instrT & 0x1800) != 0x1800) {  // LSL(1) LSR(1) ASR(1)
-
-                instr |= 0x01B00000UL | ((instrT & 0x7) << 12) | ((instrT >> 3) & 7) |
-                         ((instrT >> 6) & 0x60) | ((instrT << 1) & 0xF80);
-            } else {
-                vB = !!(instrT & 0x0200);  // SUB or ADD ?
-                instr |= ((vB ? 5UL : 9UL) << 20) | (((uint32_t)(instrT & 0x38)) << 13) |
-                         ((instrT & 0x07) << 12) | ((instrT >> 6) & 0x07);
-
-                if (instrT & 0x0400) {  // ADD(1) SUB(1)
-
-                    instr |= 0x02000000UL;
-                } else {  // ADD(3) SUB(3)
-
-                    // nothing to do here
-                }
-            }
-            break;
-
-        case 2:  // MOV(1) CMP(1) ADD(2) SUB(2)
-        case 3:
-            instr |= instrT & 0x00FF;
-            switch ((instrT >> 11) & 3) {
-                case 0:  // MOV(1)
-                    instr |= 0x03B00000UL | ((instrT & 0x0700) << 4);
-                    break;
-
-                case 1:  // CMP(1)
-                    instr |= 0x03500000UL | (((uint32_t)(instrT & 0x0700)) << 8);
-                    break;
-
-                case 2:  // ADD(2)
-                    instr |= 0x02900000UL | ((instrT & 0x0700) << 4) |
-                             (((uint32_t)(instrT & 0x0700)) << 8);
-                    break;
-
-                case 3:  // SUB(2)
-                    instr |= 0x02500000UL | ((instrT & 0x0700) << 4) |
-                             (((uint32_t)(instrT & 0x0700)) << 8);
-                    break;
-            }
-            break;
-
-        case 4:  // LDR(3) ADD(4) CMP(3) MOV(3) BX MVN CMP(2) CMN TST ADC SBC NEG MUL LSL(2)
-                 // LSR(2) ASR(2) ROR AND EOR ORR BIC
-
-            if (instrT & 0x0800) {  // LDR(3)
-                return 0;
-            } else if (instrT & 0x0400) {  // ADD(4) CMP(3) MOV(3) BX
-
-                uint8_t vD;
-
-                vD = (instrT & 7) | ((instrT >> 4) & 0x08);
-                v8 = (instrT >> 3) & 0xF;
-
-                switch ((instrT >> 8) & 3) {
-                    case 0:  // ADD(4)
-                        return 0;
-
-                    case 1:  // CMP(3)
-
-                        instr |= 0x01500000UL | (((uint32_t)vD) << 16) | v8;
-                        break;
-
-                    case 2:  // MOV(3)
-                        return 0;
-
-                    case 3:  // BX
-                        return 0;
-
-                    default:
-                        goto undefined;
-                }
-            } else {  // AND EOR LSL(2) LSR(2) ASR(2) ADC SBC ROR TST NEG CMP(2) CMN ORR MUL BIC
-                      // MVN (in val_tabl order)
-                static const uint32_t val_tabl[16] = {
-                    0x00100000UL, 0x00300000UL, 0x01B00010UL, 0x01B00030UL,
-                    0x01B00050UL, 0x00B00000UL, 0x00D00000UL, 0x01B00070UL,
-                    0x01100000UL, 0x02700000UL, 0x01500000UL, 0x01700000UL,
-                    0x01900000UL, 0x00100090UL, 0x01D00000UL, 0x01F00000UL};
-
-                // 00 = none
-                // 10 = bit0 val
-                // 11 = bit3 val
-                // MVN BIC MUL ORR CMN CMP(2) NEG TST ROR SBC ADC ASR(2) LSR(2) LSL(2) EOR AND
-
-                const uint32_t use16 = 0x2AAE280AUL;  // 0010 1010 1010 1110 0010 1000 0000 1010
-                const uint32_t use12 = 0xA208AAAAUL;  // 1010 0010 0000 1000 1010 1010 1010 1010
-                const uint32_t use8 = 0x0800C3F0UL;   // 0000 1000 0000 0000 1100 0011 1111 0000
-                const uint32_t use0 = 0xFFF3BEAFUL;   // 1111 1111 1111 0011 1011 1110 1010 1111
-                uint8_t vals[4] = {0};
-
-                vals[2] = (instrT & 7);
-                vals[3] = (instrT >> 3) & 7;
-                v8 = (instrT >> 6) & 15;
-                instr |= val_tabl[v8];
-                v8 <<= 1;
-                instr |= ((uint32_t)(vals[(use16 >> v8) & 3UL])) << 16;
-                instr |= ((uint32_t)(vals[(use12 >> v8) & 3UL])) << 12;
-                instr |= ((uint32_t)(vals[(use8 >> v8) & 3UL])) << 8;
-                instr |= ((uint32_t)(vals[(use0 >> v8) & 3UL])) << 0;
-            }
-            break;
-
-        case 5:  // STR(2)  STRH(2) STRB(2) LDRSB LDR(2) LDRH(2) LDRB(2) LDRSH		(in
-                 // val_tbl orver)
-        {
-            static const uint32_t val_tabl[8] = {0x07800000UL, 0x018000B0UL, 0x07C00000UL,
-                                                 0x019000D0UL, 0x07900000UL, 0x019000B0UL,
-                                                 0x07D00000UL, 0x019000F0UL};
-            instr |= ((instrT >> 6) & 7) | ((instrT & 7) << 12) |
-                     (((uint32_t)(instrT & 0x38)) << 13) | val_tabl[(instrT >> 9) & 7];
-        } break;
-
-        case 6:  // LDR(1) STR(1)	(bit11 set = ldr)
-
-            instr |= ((instrT & 7) << 12) | (((uint32_t)(instrT & 0x38)) << 13) |
-                     ((instrT >> 4) & 0x7C) | 0x05800000UL;
-            if (instrT & 0x0800) instr |= 0x00100000UL;
-            break;
-
-        case 7:  // LDRB(1) STRB(1)	(bit11 set = ldrb)
-
-            instr |= ((instrT & 7) << 12) | (((uint32_t)(instrT & 0x38)) << 13) |
-                     ((instrT >> 6) & 0x1F) | 0x05C00000UL;
-            if (instrT & 0x0800) instr |= 0x00100000UL;
-            break;
-
-        case 8:  // LDRH(1) STRH(1)	(bit11 set = ldrh)
-
-            instr |= ((instrT & 7) << 12) | (((uint32_t)(instrT & 0x38)) << 13) |
-                     ((instrT >> 5) & 0x0E) | ((instrT >> 1) & 0x300) | 0x01C000B0UL;
-            if (instrT & 0x0800) instr |= 0x00100000UL;
-            break;
-
-        case 9:  // LDR(4) STR(3)	(bit11 set = ldr)
-
-            instr |= ((instrT & 0x700) << 4) | ((instrT & 0xFF) << 2) | 0x058D0000UL;
-            if (instrT & 0x0800) instr |= 0x00100000UL;
-            break;
-
-        case 10:  // ADD(5) ADD(6)	(bit11 set = add(6))
-            return 0;
-
-        case 11:  // ADD(7) SUB(4) PUSH POP BKPT
-
-            if ((instrT & 0x0600) == 0x0400) {  // PUSH POP
-
-                instr |= (instrT & 0xFF) | 0x000D0000UL;
-
-                if (instrT & 0x0800) {  // POP
-
-                    if (instrT & 0x0100) instr |= 0x00008000UL;
-                    instr |= 0x08B00000UL;
-                } else {  // PUSH
-
-                    if (instrT & 0x0100) instr |= 0x00004000UL;
-                    instr |= 0x09200000UL;
-                }
-            } else if (instrT & 0x0100) {
-                goto undefined;
-            } else
-                switch ((instrT >> 9) & 7) {
-                    case 0:  // ADD(7) SUB(4)
-
-                        instr |= 0x020DDF00UL | (instrT & 0x7F) |
-                                 ((instrT & 0x0080) ? 0x00400000UL : 0x00800000UL);
-                        break;
-
-                    case 7:  // BKPT
-
-                        instr |= 0x01200070UL | (instrT & 0x0F) | ((instrT & 0xF0) << 4);
-                        break;
-
-                    default:
-
-                        goto undefined;
-                }
-            break;
-
-        case 12:  // LDMIA STMIA		(bit11 set = ldmia)
-            instr |= 0x08800000UL | (((uint32_t)(instrT & 0x700)) << 8) | (instrT & 0xFF);
-            if (instrT & 0x0800) instr |= 0x00100000UL;
-            if (!((1UL << ((instrT >> 8) & 0x07)) & instrT))
-                instr |= 0x00200000UL;  // set W bit if needed
-            break;
-
-        case 13:  // B(1), SWI, undefined instr space
-            v8 = ((instrT >> 8) & 0x0F);
-            if (v8 == 14) {  // undefined instr
-                goto undefined;
-            } else if (v8 == 15) {  // SWI
-                instr |= 0x0F000000UL | (instrT & 0xFF);
-            } else {  // B(1)
-                instr = (((uint32_t)v8) << 28) | 0x0A000000UL | (instrT & 0xFF);
-                if (instrT & 0x80) instr |= 0x00FFFF00UL;
-            }
-            break;
-
-        case 14:  // B(2) BL BLX(1) undefined instr space
-        case 15:
-            v16 = (instrT & 0x7FF);
-            switch ((instrT >> 11) & 3) {
-                case 0:  // B(2)
-
-                    instr |= 0x0A000000UL | v16;
-                    if (instrT & 0x0400) instr |= 0x00FFF800UL;
-                    break;
-
-                case 1:  // BLX(1)_suffix
-                case 2:  // BLX(1)_prefix BL_prefix
-                case 3:  // BL_suffix
-                    return 0;
-            }
-
-            if (instrT & 0x0800)
-                goto undefined;  // avoid BLX_suffix and undefined instr space in there
-            instr |= 0x0A000000UL | (instrT & 0x7FF);
-            if (instrT & 0x0400) instr |= 0x00FFF800UL;
-            break;
-    }
-
-    return instr;
-
-undefined:
-
-    return 0xE7F000F0UL | (instrT & 0x0F) |
-           ((instrT & 0xFFF0) << 4);  // guranteed undefined instr, inside it we store the
-                                      // original thumb instr :)=-)
-}
-
-static bool cpuPrvConditionTableEntry(uint8_t key) {
-    const bool N = key & 0x80, Z = key & 0x40, C = key & 0x20, V = key & 0x10;
-
-    switch (key & 0x0f) {
-        case 0:  // EQ
-            return Z;
-
-        case 1:  // NE
-            return !Z;
-
-        case 2:  // CS
-            return C;
-
-        case 3:  // CC
-            return !C;
-
-        case 4:  // MI
-            return N;
-
-        case 5:  // PL
-            return !N;
-
-        case 6:  // VS
-            return V;
-
-        case 7:  // VC
-            return !V;
-
-        case 8:  // HI
-            return C && !Z;
-
-        case 9:  // LS
-            return !C || Z;
-
-        case 10:  // GE
-            return N == V;
-
-        case 11:  // LT
-            return N != V;
-
-        case 12:  // GT
-            return !Z && N == V;
-
-        case 13:  // LE
-            return Z || N != V;
-
-        default:
-            return true;
-    }
-}
-
-static ImmShift cpuPrvImmShiftRegTableEntry(uint32_t key) {
-    const uint8_t a = key;
-    const uint8_t v = (key >> 8) & 0x03;
-
-    ImmShift shift;
-    shift.type = shiftTypeNoop;
-
-    if (a == 0) return shift;
-
-    switch (v) {  // perform shifts
-
-        case 0:  // LSL
-            if (a < 32) {
-                shift.type = shiftTypeLSL;
-                shift.coBit = 1 << (32 - a);
-                shift.shift = a;
-            } else {
-                shift.type = shiftTypeZero;
-                shift.coBit = a == 32 ? 1 : 0;
-                shift.shift = 0;
-            }
-            break;
-
-        case 1:  // LSR
-            if (a < 32) {
-                shift.type = shiftTypeLSR;
-                shift.coBit = 1 << (a - 1);
-                shift.shift = a;
-            } else {
-                shift.type = shiftTypeZero;
-                shift.coBit = a == 32 ? 0x80000000 : 0;
-                shift.shift = 0;
-            }
-            break;
-
-        case 2:  // ASR
-            shift.type = shiftTypeASR;
-
-            if (a < 32) {
-                shift.coBit = 1 << (a - 1);
-                shift.shift = a;
-            } else {
-                shift.coBit = 0x80000000;
-                shift.shift = 31;
-            }
-            break;
-
-        case 3:  // ROR
-            shift.type = shiftTypeROR;
-            shift.coBit = 1 << ((a - 1) & 0x1f);
-            shift.shift = a & 0x1f;
-
-            break;
-    }
-
-    return shift;
-}
-
-static ImmShift cpuPrvImmShiftImmTableEntry(uint32_t key) {
-    const uint8_t a = key & 0x1f;
-    const uint8_t v = (key >> 5) & 0x03;
-
-    ImmShift shift;
-    shift.type = shiftTypeNoop;
-
-    switch (v) {  // perform shifts
-
-        case 0:  // LSL
-            if (a != 0) {
-                shift.type = shiftTypeLSL;
-                shift.coBit = 1 << (32 - a);
-                shift.shift = a;
-            }
-            break;
-
-        case 1:  // LSR
-            if (a == 0) {
-                shift.type = shiftTypeZero;
-                shift.coBit = 0x80000000;
-                shift.shift = 32;
-            } else {
-                shift.type = shiftTypeLSR;
-                shift.coBit = 1 << (a - 1);
-                shift.shift = a;
-            }
-            break;
-
-        case 2:  // ASR
-            shift.type = shiftTypeASR;
-
-            if (a == 0) {
-                shift.coBit = 1 << 31;
-                shift.shift = 31;
-            } else {
-                shift.coBit = 1 << (a - 1);
-                shift.shift = a;
-            }
-            break;
-
-        case 3:  // ROR
-            if (a == 0) {
-                shift.type = shiftTypeRRX;
-            } else {
-                shift.type = shiftTypeROR;
-                shift.coBit = 1 << (a - 1);
-                shift.shift = a == 32 ? 0 : a;
-            }
-            break;
-    }
-
-    return shift;
-}
-
 void cpuReset(struct ArmCpu *cpu, uint32_t pc) {
     cpu->I = true;  // start w/o interrupts in supervisor mode
     cpu->F = true;
@@ -3202,14 +2792,13 @@ static void initStatic() {
     static bool initialized = false;
     if (initialized) return;
 
-    table_thumb2arm = (uint32_t *)malloc(0x10000 * sizeof(uint32_t));
+    // There are only 64k thumb instructions, so decode all of them ahead of time
+    table_thumbDecoded = (uint32_t *)malloc(0x10000 * sizeof(uint32_t));
 
     for (uint32_t instr = 0; instr < 0x10000; instr++)
-        table_thumb2arm[instr] = translateThumb(instr);
+        table_thumbDecoded[instr] = cpuPrvDecodeThumb(instr);
 
-    for (int i = 0; i < 256; i++) table_conditions[i] = !cpuPrvConditionTableEntry(i);
-    for (int i = 0; i < 1024; i++) table_immShiftReg[i] = cpuPrvImmShiftRegTableEntry(i);
-    for (int i = 0; i < 128; i++) table_immShiftImm[i] = cpuPrvImmShiftImmTableEntry(i);
+    initialized = true;
 }
 
 struct ArmCpu *cpuInit(uint32_t pc, struct ArmMem *mem, bool xscale, bool omap, int debugPort,
@@ -3262,6 +2851,26 @@ void cpuFinishInjectedCall(struct ArmCpu *cpu, struct ArmCpu *scratchState) {
 
 uint32_t *cpuGetRegisters(struct ArmCpu *cpu) { return cpu->regs; }
 
+bool cpuReadMemory(struct ArmCpu *cpu, void *dest, uint32_t src, uint32_t size) {
+    MemcpyResult result;
+    memcpy_armToHost((uint8_t *)dest, src, size, cpu->M != ARM_SR_MODE_USR, cpu->mem, cpu->mmu,
+                     &result);
+
+    return result.ok;
+}
+
+bool cpuWriteMemory(struct ArmCpu *cpu, uint32_t dest, const void *src, uint32_t size) {
+    MemcpyResult result;
+    memcpy_hostToArm(dest, (uint8_t *)src, size, cpu->M != ARM_SR_MODE_USR, cpu->mem, cpu->mmu,
+                     &result);
+
+    return result.ok;
+}
+
+bool cpuProbeMemory(struct ArmCpu *cpu, uint32_t addr, uint32_t size, bool write) {
+    return memcpy_probe(addr, size, write, cpu->M != ARM_SR_MODE_USR, cpu->mem, cpu->mmu);
+}
+
 void cpuExecuteInjectedCall(struct ArmCpu *cpu, uint32_t syscall) {
     const uint8_t table = syscall >> 12;
     uint32_t tableAddr;
@@ -3273,6 +2882,10 @@ void cpuExecuteInjectedCall(struct ArmCpu *cpu, uint32_t syscall) {
     if (!cpuPrvMemOpEx<4>(cpu, &entryAddr, tableAddr + offset, false, true, NULL))
         ERR("failed to dispatch syscall %#010x: unable to read entry point\n", syscall);
 
+    cpuExecuteInjectedCallAt(cpu, entryAddr);
+}
+
+void cpuExecuteInjectedCallAt(struct ArmCpu *cpu, uint32_t entryAddr) {
     cpu->regs[REG_NO_PC] = entryAddr;
     cpu->isInjectedCall = true;
     cpu->T = false;
@@ -3399,10 +3012,12 @@ static void cpuPrvPaceReturn(struct ArmCpu *cpu) {
 #endif
 }
 
-static void cpuPrvCyclePace(struct ArmCpu *cpu) {
-    switch (paceExecute()) {
+static uint32_t cpuPrvCyclePace(struct ArmCpu *cpu, uint32_t maxCycles) {
+    uint32_t cycles;
+
+    switch (paceExecute(maxCycles, &cycles)) {
         case pace_status_ok:
-            return;
+            break;
 
         case pace_status_division_by_zero:
             cpuPrvPaceDivisionByZero(cpu);
@@ -3446,6 +3061,8 @@ static void cpuPrvCyclePace(struct ArmCpu *cpu) {
             cpuPrvPaceUnimplementedlInstruction(cpu);
             break;
     }
+
+    return cycles;
 }
 
 uint32_t cpuCycle(struct ArmCpu *cpu, uint32_t cycles) {
@@ -3465,8 +3082,7 @@ uint32_t cpuCycle(struct ArmCpu *cpu, uint32_t cycles) {
         patchOnBeforeExecute(cpu->patchDispatch, cpu->regs);
 
         if (cpu->modePace) {
-            cpuPrvCyclePace(cpu);
-            cycleAcc += 10;
+            cycleAcc += cpuPrvCyclePace(cpu, cycles - cycleAcc);
         } else if (cpu->T) {
             cpuPrvCycleThumb(cpu);
             cycleAcc += 1;
@@ -3519,3 +3135,32 @@ void cpuWakeup(struct ArmCpu *cpu) { cpu->sleeping = false; }
 void cpuSetPid(struct ArmCpu *cpu, uint32_t pid) { cpu->pid = pid; }
 
 uint32_t cpuGetPid(struct ArmCpu *cpu) { return cpu->pid; }
+
+void cpuSetCodePageTracking(struct ArmCpu *cpu, uint32_t ramBase, struct RamBuffer *ramBuffer) {
+    icacheSetCodePageTracking(cpu->ic, ramBase, ramBuffer);
+    paceSetCodePageTracking(ramBase);
+}
+
+void cpuCodePageWritten(struct ArmCpu *cpu, uint32_t ramOffset) {
+    icacheCodePageWritten(cpu->ic, ramOffset);
+    paceCodePageWritten(ramOffset);
+}
+
+void cpuIcacheInval(struct ArmCpu *cpu) { icacheInval(cpu->ic); }
+
+void cpuGetPcSample(struct ArmCpu *cpu, struct PcSample *sample) {
+    sample->lr = cpu->regs[REG_NO_LR];
+
+    if (cpu->modePace) {
+        sample->mode = PcSampleModePace;
+        sample->pc = paceGetPc();
+    } else {
+        sample->mode = cpu->T ? PcSampleModeThumb : PcSampleModeArm;
+        sample->pc = cpu->regs[REG_NO_PC];
+    }
+}
+
+void cpuSetPredecodedRom(struct ArmCpu *cpu, uint32_t romBase, uint32_t romSize,
+                         const uint32_t *decoded) {
+    icacheSetPredecodedRom(cpu->ic, romBase, romSize, decoded);
+}
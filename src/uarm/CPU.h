@@ -62,6 +62,8 @@ typedef bool (*ArmCoprocTwoRegF)(struct ArmCpu *cpu, void *userData, bool MRRC,
                                  uint8_t Rd, uint8_t Rn, uint8_t CRm);
 
 struct PatchDispatch;
+struct PcSample;
+struct RamBuffer;
 
 struct ArmCoprocessor {
     ArmCoprocRegXferF regXfer;
@@ -78,7 +80,13 @@ struct ArmCpu *cpuInit(uint32_t pc, struct ArmMem *mem, bool xscale, bool omap,
 struct ArmCpu *cpuPrepareInjectedCall(struct ArmCpu *cpu, struct ArmCpu *scratchState);
 void cpuFinishInjectedCall(struct ArmCpu *cpu, struct ArmCpu *scratchState);
 uint32_t *cpuGetRegisters(struct ArmCpu *cpu);
+// Access guest memory through the MMU with the current privilege level. No fault is raised.
+bool cpuReadMemory(struct ArmCpu *cpu, void *dest, uint32_t src, uint32_t size);
+bool cpuWriteMemory(struct ArmCpu *cpu, uint32_t dest, const void *src, uint32_t size);
+// Check whether the above would succeed for a whole range without touching memory
+bool cpuProbeMemory(struct ArmCpu *cpu, uint32_t addr, uint32_t size, bool write);
 void cpuExecuteInjectedCall(struct ArmCpu *cpu, uint32_t syscall);
+void cpuExecuteInjectedCallAt(struct ArmCpu *cpu, uint32_t entryAddr);
 
 void cpuReset(struct ArmCpu *cpu, uint32_t pc);
 
@@ -99,11 +107,21 @@ uint32_t cpuGetPid(struct ArmCpu *cpu);
 uint16_t cpuGetCPAR(struct ArmCpu *cpu);
 void cpuSetCPAR(struct ArmCpu *cpu, uint16_t cpar);
 
+void cpuIcacheInval(struct ArmCpu *cpu);
+
+void cpuGetPcSample(struct ArmCpu *cpu, struct PcSample *sample);
+
+void cpuSetCodePageTracking(struct ArmCpu *cpu, uint32_t ramBase, struct RamBuffer *ramBuffer);
+void cpuCodePageWritten(struct ArmCpu *cpu, uint32_t ramOffset);
+void cpuSetPredecodedRom(struct ArmCpu *cpu, uint32_t romBase, uint32_t romSize,
+                         const uint32_t *decoded);
+
 void cpuSetSleeping(struct ArmCpu *cpu);
 void cpuWakeup(struct ArmCpu *cpu);
 
 uint32_t cpuDecodeArm(uint32_t instr);
 uint32_t cpuDecodeThumb(uint32_t instr);
+uint64_t cpuGetDecoderId(void);
 
 #ifdef __cplusplus
 }
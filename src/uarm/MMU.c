@@ -11,6 +11,10 @@
 #define TRANSLATE_RESULT_FAULT(fsr) ((1ull << 63) | ((uint64_t)(fsr) << 32))
 #define TLB_SIZE (1 << 20)
 
+#define PERM_WRITE_USER 0x01
+#define PERM_WRITE_PRIV 0x02
+#define PERM_WRITE_MASK(priviledged) (PERM_WRITE_USER << (priviledged))
+
 struct TlbEntry {
     uint32_t pa;
 
@@ -29,12 +33,18 @@ struct ArmMmu {
     uint8_t xscale : 1;
     uint32_t domainCfg;
 
+    // write permissions by domain and AP, kept in sync with DACR
+    uint8_t writePermissions[16][4];
+    uint32_t permissionGeneration;
+
     struct TlbEntry tlb[TLB_SIZE];
     uint16_t revision;
+    uint32_t generation;
 };
 
 void mmuTlbFlush(struct ArmMmu *mmu) {
     mmu->revision++;
+    mmu->generation++;
 
     if (mmu->revision == 0) {
         mmu->revision = 1;
@@ -63,38 +73,28 @@ struct ArmMmu *mmuInit(struct ArmMem *mem, bool xscaleMode) {
 
 bool mmuIsOn(struct ArmMmu *mmu) { return mmu->transTablPA != MMU_DISABLED_TTP; }
 
-static inline uint8_t checkPermissionsForWrite(struct ArmMmu *mmu, uint_fast8_t ap,
-                                               uint_fast8_t domain, bool section,
-                                               bool priviledged) {
+// Write permissions by domain access type (DACR) and AP
+static const uint8_t writePermissionsByAccess[4][4] = {
+    // NO ACCESS
+    {0, 0, 0, 0},
+    // CLIENT: check permissions
+    {0, PERM_WRITE_PRIV, PERM_WRITE_PRIV, PERM_WRITE_USER | PERM_WRITE_PRIV},
+    // RESERVED: unpredictable (treat as no access)
+    {0, 0, 0, 0},
+    // MANAGER: allow all access
+    {PERM_WRITE_USER | PERM_WRITE_PRIV, PERM_WRITE_USER | PERM_WRITE_PRIV,
+     PERM_WRITE_USER | PERM_WRITE_PRIV, PERM_WRITE_USER | PERM_WRITE_PRIV}};
+
+// Only called once the precomputed permissions have denied the access
+static uint8_t calculateWriteFsr(struct ArmMmu *mmu, uint_fast8_t domain, bool section) {
     switch ((mmu->domainCfg >> (domain * 2)) & 3) {
-        case 0:  // NO ACCESS:
-        case 2:  // RESERVED: unpredictable	(treat as no access)
-            return (section ? 0x08 : 0xB) | (domain << 4);  // section or page domain fault
-
-        case 1:  // CLIENT: check permissions
-            break;
-
-        case 3:  // MANAGER: allow all access
-            return 0;
-    }
-
-    // check permissions
-
-    switch (ap) {
         case 0:
-            break;
-
-        case 1:
         case 2:
-            if (!priviledged) break;
-            return 0;
+            return (section ? 0x08 : 0xB) | (domain << 4);  // section or page domain fault
 
-        case 3:
-            return 0;
+        default:
+            return (section ? 0x0D : 0x0F) | (domain << 4);  // section or subpage permission fault
     }
-
-    // perm_err:
-    return (section ? 0x0D : 0x0F) | (domain << 4);  // section or subpage permission fault
 }
 
 static FORCE_INLINE MMUTranslateResult translateAndCache(struct ArmMmu *mmu, uint32_t adr,
@@ -104,7 +104,6 @@ static FORCE_INLINE MMUTranslateResult translateAndCache(struct ArmMmu *mmu, uin
     uint32_t va, paPage = 0, sz, t, pa;
     int_fast16_t i;
     uint_fast8_t dom, ap = 0;
-    uint8_t fsr;
     MMUTranslateResult result;
 
     // read first level table
@@ -225,10 +224,8 @@ translated:
         }
     }
 
-    if (write) {
-        fsr = checkPermissionsForWrite(mmu, ap, dom, section, priviledged);
-        if (fsr) return TRANSLATE_RESULT_FAULT(fsr);
-    }
+    if (write && !(mmu->writePermissions[dom][ap] & PERM_WRITE_MASK(priviledged)))
+        return TRANSLATE_RESULT_FAULT(calculateWriteFsr(mmu, dom, section));
 
     result = pa;
 
@@ -246,12 +243,10 @@ MMUTranslateResult mmuTranslate(struct ArmMmu *mmu, uint32_t addr, bool priviled
         return translateAndCache(mmu, addr, priviledged, write);
     }
 
-    if (write) {
-        uint8_t fsr = checkPermissionsForWrite(mmu, tlbEntry->ap, tlbEntry->domain,
-                                               tlbEntry->section, priviledged);
-
-        if (fsr) return TRANSLATE_RESULT_FAULT(fsr);
-    }
+    if (write &&
+        !(mmu->writePermissions[tlbEntry->domain][tlbEntry->ap] & PERM_WRITE_MASK(priviledged)))
+        return TRANSLATE_RESULT_FAULT(
+            calculateWriteFsr(mmu, tlbEntry->domain, tlbEntry->section));
 
     uint64_t result = (addr & 0xfff) + tlbEntry->pa;
 
@@ -267,9 +262,19 @@ void mmuSetTTP(struct ArmMmu *mmu, uint32_t ttp) {
     mmu->transTablPA = ttp;
 }
 
-void mmuSetS(struct ArmMmu *mmu, bool on) { mmu->S = on; }
+void mmuSetS(struct ArmMmu *mmu, bool on) {
+    if (on != mmu->S) mmuTlbFlush(mmu);
+
+    mmu->S = on;
+}
+
+void mmuSetR(struct ArmMmu *mmu, bool on) {
+    if (on != mmu->R) mmuTlbFlush(mmu);
 
-void mmuSetR(struct ArmMmu *mmu, bool on) { mmu->R = on; }
+    mmu->R = on;
+}
+
+uint32_t mmuGetGeneration(struct ArmMmu *mmu) { return mmu->generation; }
 
 bool mmuGetS(struct ArmMmu *mmu) { return mmu->S; }
 
@@ -277,7 +282,28 @@ bool mmuGetR(struct ArmMmu *mmu) { return mmu->R; }
 
 uint32_t mmuGetDomainCfg(struct ArmMmu *mmu) { return mmu->domainCfg; }
 
-void mmuSetDomainCfg(struct ArmMmu *mmu, uint32_t val) { mmu->domainCfg = val; }
+void mmuSetDomainCfg(struct ArmMmu *mmu, uint32_t val) {
+    const uint32_t changed = val ^ mmu->domainCfg;
+    bool revoked = false;
+
+    mmu->domainCfg = val;
+
+    // TLB entries keep domain and AP, so only the table rows of changed domains need updating
+    for (uint_fast8_t domain = 0; domain < 16; domain++) {
+        if (!((changed >> (domain * 2)) & 3)) continue;
+
+        const uint8_t *perms = writePermissionsByAccess[(val >> (domain * 2)) & 3];
+
+        for (uint_fast8_t ap = 0; ap < 4; ap++)
+            revoked = revoked || (mmu->writePermissions[domain][ap] & ~perms[ap]);
+
+        memcpy(mmu->writePermissions[domain], perms, sizeof(mmu->writePermissions[domain]));
+    }
+
+    if (revoked) mmu->permissionGeneration++;
+}
+
+uint32_t mmuGetPermissionGeneration(struct ArmMmu *mmu) { return mmu->permissionGeneration; }
 
 ///////////////////////////  debugging helpers  ///////////////////////////
 
@@ -44,6 +44,12 @@ uint32_t mmuGetDomainCfg(struct ArmMmu *mmu);
 void mmuSetDomainCfg(struct ArmMmu *mmu, uint32_t val);
 
 void mmuTlbFlush(struct ArmMmu *mmu);
+// Changes whenever the TLB is flushed. Lets translation caches outside the MMU validate
+// themselves.
+uint32_t mmuGetGeneration(struct ArmMmu *mmu);
+// Changes whenever a DACR write takes write access away. Host pointers cached for writing
+// must be dropped then, the TLB itself stays valid.
+uint32_t mmuGetPermissionGeneration(struct ArmMmu *mmu);
 
 void mmuDump(struct ArmMmu *mmu);  // for calling in GDB :)
 
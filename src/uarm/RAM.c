@@ -16,15 +16,47 @@ struct ArmRam {
     struct SoC* soc;
 
     uint32_t framebufferStart;
-    uint32_t framebufferStart_2;
-    uint32_t framebufferStart_4;
-    uint32_t framebufferStart_8;
-    uint32_t framebufferStart_16;
-    uint32_t framebufferStart_32;
-    uint32_t framebufferStart_64;
-    uint32_t framebufferEnd;
+    uint32_t framebufferSize;
 };
 
+static void ramPrvFramebufferWritten(struct ArmRam* ram, uint32_t offset, uint32_t size) {
+    const uint32_t fbStart = ram->framebufferStart, fbEnd = fbStart + ram->framebufferSize;
+    if (offset >= fbEnd || offset + size <= fbStart) return;
+
+    const uint32_t start = offset > fbStart ? offset : fbStart;
+    const uint32_t end = offset + size < fbEnd ? offset + size : fbEnd;
+
+    socMarkFramebufferDirty(ram->soc, start - fbStart, end - start);
+}
+
+static void ramPrvWatchedPageWritten(struct ArmRam* ram, uint32_t offset, uint32_t size) {
+    const uint32_t last = offset + size - 1;
+    const uint8_t reasons =
+        RAM_BUFFER_WATCH_REASONS(ram->buf, offset) | RAM_BUFFER_WATCH_REASONS(ram->buf, last);
+
+    if (reasons & RAM_BUFFER_WATCH_CODE) {
+        if (RAM_BUFFER_IS_CODE(ram->buf, offset)) socCodePageWritten(ram->soc, offset);
+        if (size > 4 && RAM_BUFFER_IS_CODE(ram->buf, last)) socCodePageWritten(ram->soc, last);
+    }
+
+    if (reasons & RAM_BUFFER_WATCH_FRAMEBUFFER) ramPrvFramebufferWritten(ram, offset, size);
+}
+
+static void ramPrvWatchFramebuffer(struct ArmRam* ram, bool watch) {
+    if (ram->framebufferSize == 0) return;
+
+    const uint32_t pageSize = 1 << RAM_BUFFER_WATCH_PAGE_BITS;
+    const uint32_t first = ram->framebufferStart & ~(pageSize - 1);
+
+    for (uint32_t page = first; page < ram->framebufferStart + ram->framebufferSize;
+         page += pageSize) {
+        if (watch)
+            ramBufferWatch(&ram->buf, page, RAM_BUFFER_WATCH_FRAMEBUFFER);
+        else
+            ramBufferUnwatch(&ram->buf, page, RAM_BUFFER_WATCH_FRAMEBUFFER);
+    }
+}
+
 bool ramAccessF(void* userData, uint32_t pa, uint_fast8_t size, bool write, void* bufP) {
     struct ArmRam* ram = (struct ArmRam*)userData;
     const uint32_t offset = pa - ram->adr;
@@ -33,33 +65,25 @@ bool ramAccessF(void* userData, uint32_t pa, uint_fast8_t size, bool write, void
     if (write) {
         RAM_BUFFER_MARK_DIRTY(ram->buf, offset);
 
+        if (RAM_BUFFER_IS_WATCHED(ram->buf, offset) ||
+            (size > 4 && RAM_BUFFER_IS_WATCHED(ram->buf, offset + size - 1)))
+            ramPrvWatchedPageWritten(ram, offset, size);
+
         switch (size) {
             case 1:
-                if (offset < ram->framebufferEnd && offset >= ram->framebufferStart)
-                    socSetFramebufferDirty(ram->soc);
-
                 *((uint8_t*)addr) = *(uint8_t*)bufP;  // our memory system is little-endian
                 break;
 
             case 2:
-                if (offset < ram->framebufferEnd && offset >= ram->framebufferStart_2)
-                    socSetFramebufferDirty(ram->soc);
-
                 *((uint16_t*)addr) =
                     htole16(*(uint16_t*)bufP);  // our memory system is little-endian
                 break;
 
             case 4:
-                if (offset < ram->framebufferEnd && offset >= ram->framebufferStart_4)
-                    socSetFramebufferDirty(ram->soc);
-
                 *((uint32_t*)addr) = htole32(*(uint32_t*)bufP);
                 break;
 
             case 64:
-                if (offset < ram->framebufferEnd && offset >= ram->framebufferStart_64)
-                    socSetFramebufferDirty(ram->soc);
-
                 if (offset & 0x3f) RAM_BUFFER_MARK_DIRTY(ram->buf, offset + 0x3f);
 
                 *((uint64_t*)(addr + 0)) = htole64(((uint64_t*)bufP)[0]);
@@ -73,9 +97,6 @@ bool ramAccessF(void* userData, uint32_t pa, uint_fast8_t size, bool write, void
                 break;
 
             case 32:
-                if (offset < ram->framebufferEnd && offset >= ram->framebufferStart_32)
-                    socSetFramebufferDirty(ram->soc);
-
                 if (offset & 0x1f) RAM_BUFFER_MARK_DIRTY(ram->buf, offset + 0x1f);
 
                 *((uint64_t*)(addr + 0)) = htole64(((uint64_t*)bufP)[0]);
@@ -85,9 +106,6 @@ bool ramAccessF(void* userData, uint32_t pa, uint_fast8_t size, bool write, void
                 break;
 
             case 16:
-                if (offset < ram->framebufferEnd && offset >= ram->framebufferStart_16)
-                    socSetFramebufferDirty(ram->soc);
-
                 if (offset & 0x0f) RAM_BUFFER_MARK_DIRTY(ram->buf, offset + 0x0f);
 
                 *((uint64_t*)(addr + 0)) = htole64(((uint64_t*)bufP)[0]);
@@ -95,9 +113,6 @@ bool ramAccessF(void* userData, uint32_t pa, uint_fast8_t size, bool write, void
                 break;
 
             case 8:
-                if (offset < ram->framebufferEnd && offset >= ram->framebufferStart_8)
-                    socSetFramebufferDirty(ram->soc);
-
                 *((uint64_t*)(addr + 0)) = htole64(((uint64_t*)bufP)[0]);
                 break;
 
@@ -150,25 +165,25 @@ bool ramAccessF(void* userData, uint32_t pa, uint_fast8_t size, bool write, void
 }
 
 void ramSetFramebuffer(struct ArmRam* ram, uint32_t base, uint32_t size) {
-    if (size > 0) {
-        ram->framebufferStart = base - ram->adr;
-        ram->framebufferStart_2 = ram->framebufferStart - 2;
-        ram->framebufferStart_4 = ram->framebufferStart - 4;
-        ram->framebufferStart_8 = ram->framebufferStart - 8;
-        ram->framebufferStart_16 = ram->framebufferStart - 16;
-        ram->framebufferStart_32 = ram->framebufferStart - 32;
-        ram->framebufferStart_64 = ram->framebufferStart - 64;
-        ram->framebufferEnd = ram->framebufferStart + size;
-    } else {
-        ram->framebufferStart = base - ram->adr;
-        ram->framebufferStart_2 = 0;
-        ram->framebufferStart_4 = 0;
-        ram->framebufferStart_8 = 0;
-        ram->framebufferStart_16 = 0;
-        ram->framebufferStart_32 = 0;
-        ram->framebufferStart_64 = 0;
-        ram->framebufferEnd = 0xffffffff;
-    }
+    ramPrvWatchFramebuffer(ram, false);
+
+    ram->framebufferStart = base - ram->adr;
+    ram->framebufferSize = size;
+
+    ramPrvWatchFramebuffer(ram, true);
+}
+
+bool ramGetHostPage(struct ArmRam* ram, uint32_t pa, bool write, struct MemHostPage* page) {
+    const uint32_t offset = pa - ram->adr;
+
+    page->host = (uint8_t*)ram->buf.buffer + offset;
+    page->dirtyWord = &ram->buf.dirtyPages[offset >> 14];
+    page->dirtyMask = 3u << ((offset >> 9) & 0x1f);
+    page->watchWord = &ram->buf.watchPages[offset >> 15];
+    page->watchMask = 1u << ((offset >> 10) & 0x1f);
+    page->watchReasons = &RAM_BUFFER_WATCH_REASONS(ram->buf, offset);
+
+    return true;
 }
 
 struct ArmRam* ramInit(struct ArmMem* mem, struct SoC* soc, uint32_t adr, uint32_t sz,
@@ -6,14 +6,26 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "CPU.h"
 #include "mem.h"
 #include "uarm_endian.h"
 #include "util.h"
 
+#define DECODE_CACHE_MAGIC 0x43454475  // uDEC
+#define DECODE_CACHE_VERIFY_STRIDE 256
+
 struct ArmRom {
     uint32_t base, size;
     uint32_t *data;
     uint32_t *dataPeephole;
+    uint32_t *decoded;
+};
+
+struct DecodeCacheHeader {
+    uint32_t magic;
+    uint32_t romSize;
+    uint64_t romHash;
+    uint64_t decoderId;
 };
 
 static inline bool access(uint8_t *source, uint_fast8_t size, void *bufP) {
@@ -74,6 +86,13 @@ bool romInstructionFetch(void *userData, uint32_t pa, uint_fast8_t size, void *b
     return access((uint8_t *)rom->dataPeephole + (pa - rom->base), size, bufP);
 }
 
+bool romGetHostPage(struct ArmRom *rom, uint32_t pa, struct MemHostPage *page) {
+    memset(page, 0, sizeof(*page));
+    page->host = (uint8_t *)rom->data + (pa - rom->base);
+
+    return true;
+}
+
 struct ArmRom *romInit(struct ArmMem *mem, uint32_t adr, void *data, const uint32_t size) {
     struct ArmRom *rom = (struct ArmRom *)malloc(sizeof(*rom));
     if (!rom) ERR("cannot alloc ROM at 0x%08x", adr);
@@ -95,4 +114,75 @@ struct ArmRom *romInit(struct ArmMem *mem, uint32_t adr, void *data, const uint3
     return rom;
 }
 
-void *romGetPeepholeBuffer(struct ArmRom *rom) { return rom->dataPeephole; }
\ No newline at end of file
+void *romGetPeepholeBuffer(struct ArmRom *rom) { return rom->dataPeephole; }
+uint32_t romGetSize(struct ArmRom *rom) { return rom->size; }
+
+static bool romPrvLoadDecodeCache(struct ArmRom *rom, const char *cachePath,
+                                  const struct DecodeCacheHeader *expectedHeader) {
+    struct DecodeCacheHeader header;
+    const size_t count = rom->size / 4;
+    bool ok = false;
+
+    FILE *f = fopen(cachePath, "rb");
+    if (!f) return false;
+
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        memcmp(&header, expectedHeader, sizeof(header)) != 0)
+        goto out;
+
+    if (fread(rom->decoded, sizeof(uint32_t), count, f) != count) goto out;
+
+    // spot check in case the binary changed in a way that the decoder id did not catch
+    for (size_t i = 0; i < count; i += DECODE_CACHE_VERIFY_STRIDE) {
+        if (rom->decoded[i] != cpuDecodeArm(le32toh(rom->dataPeephole[i]))) goto out;
+    }
+
+    ok = true;
+
+out:
+    fclose(f);
+    return ok;
+}
+
+static void romPrvSaveDecodeCache(struct ArmRom *rom, const char *cachePath,
+                                  const struct DecodeCacheHeader *header) {
+    FILE *f = fopen(cachePath, "wb");
+    if (!f) {
+        fprintf(stderr, "unable to write decode cache %s\n", cachePath);
+        return;
+    }
+
+    if (fwrite(header, sizeof(*header), 1, f) != 1 ||
+        fwrite(rom->decoded, sizeof(uint32_t), rom->size / 4, f) != rom->size / 4)
+        fprintf(stderr, "failed to write decode cache %s\n", cachePath);
+
+    fclose(f);
+}
+
+const uint32_t *romPredecode(struct ArmRom *rom, const char *cachePath) {
+    if (rom->decoded) return rom->decoded;
+
+    const size_t count = rom->size / 4;
+
+    rom->decoded = (uint32_t *)malloc(count * sizeof(uint32_t));
+    if (!rom->decoded) ERR("failed to allocate decode buffer for ROM");
+
+    const struct DecodeCacheHeader header = {
+        .magic = DECODE_CACHE_MAGIC,
+        .romSize = rom->size,
+        .romHash = fnv1a64(rom->dataPeephole, rom->size, FNV1A64_INIT),
+        .decoderId = cpuGetDecoderId(),
+    };
+
+    if (cachePath && romPrvLoadDecodeCache(rom, cachePath, &header)) {
+        fprintf(stderr, "loaded ROM decode cache from %s\n", cachePath);
+        return rom->decoded;
+    }
+
+    for (size_t i = 0; i < count; i++)
+        rom->decoded[i] = cpuDecodeArm(le32toh(rom->dataPeephole[i]));
+
+    if (cachePath) romPrvSaveDecodeCache(rom, cachePath, &header);
+
+    return rom->decoded;
+}
@@ -17,11 +17,18 @@ struct ArmRom;
 struct ArmRom *romInit(struct ArmMem *mem, uint32_t adr, void *data, const uint32_t size);
 
 void *romGetPeepholeBuffer(struct ArmRom *rom);
+uint32_t romGetSize(struct ArmRom *rom);
+
+// Decode the (patched) ROM as ARM code. If cachePath is set the result is loaded from and
+// persisted to disk.
+const uint32_t *romPredecode(struct ArmRom *rom, const char *cachePath);
 
 bool romAccessF(void *userData, uint32_t pa, uint_fast8_t size, bool write, void *bufP);
 
 bool romInstructionFetch(void *userData, uint32_t pa, uint_fast8_t size, void *bufP);
 
+bool romGetHostPage(struct ArmRom *rom, uint32_t pa, struct MemHostPage *page);
+
 #ifdef __cplusplus
 }
 #endif
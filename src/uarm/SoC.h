@@ -31,9 +31,28 @@ uint64_t socRun(struct SoC *soc, uint64_t maxCycles, uint64_t cyclesPerSecond);
 
 void socBootload(struct SoC *soc, uint32_t method, void *param);  // soc-specific
 
+struct FrameDamageSpan {
+    uint16_t firstRow;
+    uint16_t nRows;
+};
+
+enum FrameFormat { frameFormatAbgr8888 = 0, frameFormatRgb565 = 1, frameFormatIndexed8 = 2 };
+
 uint32_t *socGetPendingFrame(struct SoC *soc);
 void socResetPendingFrame(struct SoC *soc);
 
+// Deliver 16bpp frames as RGB565 and palettized frames as 8 bit indices instead of ABGR8888
+void socSetNativeFrameFormat(struct SoC *soc, bool enable);
+enum FrameFormat socGetPendingFrameFormat(struct SoC *soc);
+// 256 ABGR8888 entries, valid for frameFormatIndexed8
+const uint32_t *socGetPendingFramePalette(struct SoC *soc);
+
+// Refresh rate seen by the guest and rate at which frames are captured for the host
+void socSetLcdRefreshRate(struct SoC *soc, uint32_t refreshHz, uint32_t captureHz);
+
+// Rows of the pending frame that changed since the last frame that was reset
+const struct FrameDamageSpan *socGetPendingFrameDamage(struct SoC *soc, uint32_t *nSpans);
+
 void socKeyDown(struct SoC *soc, enum KeyId key);
 void socKeyUp(struct SoC *soc, enum KeyId key);
 void socPenDown(struct SoC *soc, int x, int y);
@@ -47,8 +66,20 @@ void socExtSerialWriteChar(int ch);
 int socExtSerialReadChar(void);
 
 void socSetFramebufferDirty(struct SoC *soc);
+void socMarkFramebufferDirty(struct SoC *soc, uint32_t offset, uint32_t size);
 bool socSetFramebuffer(struct SoC *soc, uint32_t start, uint32_t size);
 
+void socCodePageWritten(struct SoC *soc, uint32_t ramOffset);
+
+void socPredecodeRom(struct SoC *soc, const char *cachePath);
+
+// Guest PC sampling at rateHz emulated time, written as folded stacks
+bool socStartPcSampling(struct SoC *soc, uint32_t rateHz, const char *symbolPath);
+void socWritePcSamples(struct SoC *soc, FILE *file);
+
+void socSetSyscallProfiling(struct SoC *soc, bool enable);
+void socDumpSyscallProfile(struct SoC *soc, FILE *file, bool csv);
+
 void socSetAudioQueue(struct SoC *soc, struct AudioQueue *audioQueue);
 void socSetPcmSuspended(struct SoC *soc, bool pcmSuspended);
 
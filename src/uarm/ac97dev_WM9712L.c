@@ -9,6 +9,15 @@
 #include "audio_queue.h"
 #include "util.h"
 
+// AC97 link frames run at 48 kHz. With variable rate audio the DAC requests a sample in some
+// frames only, so a block never consumes more samples than it has frames.
+#define WM9712L_FRAME_RATE 48000
+#define WM9712L_MIN_RATE 8000
+
+// The TX FIFO only guarantees 8 samples between two DMA bursts
+#define WM9712L_MAX_BLOCK 8
+#define WM9712L_MAX_OUTPUT 64
+
 enum WM9712REG {
     RESET = 0x00,
     OUT2VOL = 0x02,
@@ -93,6 +102,14 @@ struct WM9712L {
     uint8_t cooIdx, numUnreadDatas;
     uint16_t otherTwo[2];
 
+    // DAC samples are requested at the DAC rate and interpolated to the output rate. The slot
+    // phase accumulates the DAC rate per frame, the resample phase is the position of the
+    // next output sample relative to the older of the two most recent samples in 16.16 fixed
+    // point.
+    uint32_t dacSlotPhase;
+    uint32_t resamplePhase;
+    uint32_t resamplePrev, resampleNext;
+
     struct AudioQueue *audioQueue;
 };
 
@@ -425,6 +442,8 @@ struct WM9712L *wm9712LInit(struct SocAC97 *ac97, struct SocGpio *gpio, int8_t p
     wm->auxDacRate = 0xbb80;
     wm->adcRate = 0xbb80;
 
+    wm->resamplePhase = 0x10000;
+
     socAC97clientAdd(ac97, Ac97PrimaryAudio, wm9712LprvCodecRegR, wm9712LprvCodecRegW, wm);
     socAC97clientAdd(ac97, Ac97SecondaryAudio, wm9712LprvUnusedRegR, wm9712LprvUnusedRegW, wm);
     socAC97clientAdd(ac97, Ac97PrimaryModem, wm9712LprvUnusedRegR, wm9712LprvUnusedRegW, wm);
@@ -432,18 +451,57 @@ struct WM9712L *wm9712LInit(struct SocAC97 *ac97, struct SocGpio *gpio, int8_t p
     return wm;
 }
 
-static void wm9712LprvNewAudioPlaybackSample(struct WM9712L *wm, uint32_t samp) {
-    if (wm->audioQueue) audioQueuePush(wm->audioQueue, samp);
+static uint32_t wm9712LprvDacRate(struct WM9712L *wm) {
+    // variable rate audio enabled?
+    if (!(wm->extdCtl & 0x0001) || wm->dacRate > WM9712L_FRAME_RATE) return WM9712L_FRAME_RATE;
+
+    return wm->dacRate < WM9712L_MIN_RATE ? WM9712L_MIN_RATE : wm->dacRate;
 }
 
-static bool wm9712LprvHaveAudioOutSample(struct WM9712L *wm, uint32_t *sampP) {
-    *sampP = 0;
-    return true;
+static int32_t wm9712LprvLerp(int16_t a, int16_t b, uint32_t phase) {
+    return a + (((int32_t)b - a) * (int32_t)(phase >> 1) >> 15);
 }
 
-static bool wm9712LprvHaveMicOutSample(struct WM9712L *wm, uint32_t *sampP) {
-    *sampP = 0;
-    return true;
+static uint32_t wm9712LprvInterpolate(uint32_t a, uint32_t b, uint32_t phase) {
+    const int32_t left = wm9712LprvLerp(a, b, phase);
+    const int32_t right = wm9712LprvLerp(a >> 16, b >> 16, phase);
+
+    return (uint16_t)left | ((uint32_t)(uint16_t)right << 16);
+}
+
+static void wm9712LprvPlaybackBlock(struct WM9712L *wm, uint32_t nFrames, uint32_t outputHz) {
+    uint32_t input[WM9712L_MAX_BLOCK];
+    uint32_t output[WM9712L_MAX_OUTPUT];
+    uint32_t nOutput = 0;
+
+    const uint32_t dacRate = wm9712LprvDacRate(wm);
+    const uint32_t step = ((uint64_t)dacRate << 16) / outputHz;
+
+    // one slot request for each frame in which the DAC phase wraps
+    wm->dacSlotPhase += nFrames * dacRate;
+    uint32_t nInput = wm->dacSlotPhase / WM9712L_FRAME_RATE;
+    wm->dacSlotPhase %= WM9712L_FRAME_RATE;
+
+    // an underrun leaves the resampler where it is, we do not make up samples
+    nInput = socAC97clientClientWantDataN(wm->ac97, Ac97PrimaryAudio, input, nInput);
+
+    for (uint32_t i = 0; i < nInput; i++) {
+        wm->resamplePrev = wm->resampleNext;
+        wm->resampleNext = input[i];
+        wm->resamplePhase -= 0x10000;
+
+        for (; wm->resamplePhase < 0x10000; wm->resamplePhase += step) {
+            output[nOutput++] =
+                wm9712LprvInterpolate(wm->resamplePrev, wm->resampleNext, wm->resamplePhase);
+
+            if (nOutput == WM9712L_MAX_OUTPUT) {
+                if (wm->audioQueue) audioQueuePushChunk(wm->audioQueue, output, nOutput);
+                nOutput = 0;
+            }
+        }
+    }
+
+    if (wm->audioQueue && nOutput > 0) audioQueuePushChunk(wm->audioQueue, output, nOutput);
 }
 
 static uint16_t wm9712LprvGetSample(struct WM9712L *wm, enum WM9712LsampleIdx which) {
@@ -557,20 +615,28 @@ static bool wm9712LprvHaveModemOutSample(struct WM9712L *wm, uint32_t *sampP) {
     return false;
 }
 
-void wm9712Lperiodic(struct WM9712L *wm) {
+static void wm9712LprvBlock(struct WM9712L *wm, uint32_t nFrames, uint32_t outputHz) {
+    static const uint32_t silence[WM9712L_MAX_BLOCK];
     uint32_t val;
 
-    if (socAC97clientClientWantData(wm->ac97, Ac97PrimaryAudio, &val))
-        wm9712LprvNewAudioPlaybackSample(wm, val);
+    wm9712LprvPlaybackBlock(wm, nFrames, outputHz);
 
-    if (wm9712LprvHaveAudioOutSample(wm, &val))
-        socAC97clientClientHaveData(wm->ac97, Ac97PrimaryAudio, val);
+    // line in and mic are silent
+    socAC97clientClientHaveDataN(wm->ac97, Ac97PrimaryAudio, silence, nFrames);
+    socAC97clientClientHaveDataN(wm->ac97, Ac97SecondaryAudio, silence, nFrames);
 
-    if (wm9712LprvHaveMicOutSample(wm, &val))
-        socAC97clientClientHaveData(wm->ac97, Ac97SecondaryAudio, val);
+    for (uint32_t i = 0; i < nFrames; i++)
+        if (wm9712LprvHaveModemOutSample(wm, &val))
+            socAC97clientClientHaveData(wm->ac97, Ac97PrimaryModem, val);
+}
 
-    if (wm9712LprvHaveModemOutSample(wm, &val))
-        socAC97clientClientHaveData(wm->ac97, Ac97PrimaryModem, val);
+void wm9712Lperiodic(struct WM9712L *wm, uint32_t nFrames, uint32_t outputHz) {
+    while (nFrames > 0) {
+        const uint32_t n = nFrames > WM9712L_MAX_BLOCK ? WM9712L_MAX_BLOCK : nFrames;
+
+        wm9712LprvBlock(wm, n, outputHz);
+        nFrames -= n;
+    }
 
     wm9712LprvGpioRecalc(wm);
 }
@@ -26,7 +26,7 @@ enum WM9712LauxPin {  // Vref is 3.3v,
 };
 
 struct WM9712L *wm9712LInit(struct SocAC97 *ac97, struct SocGpio *gpio, int8_t penDownPin);
-void wm9712Lperiodic(struct WM9712L *wm);
+void wm9712Lperiodic(struct WM9712L *wm, uint32_t nFrames, uint32_t outputHz);
 
 void wm9712LsetAuxVoltage(struct WM9712L *wm, enum WM9712LauxPin which, uint32_t mV);
 void wm9712LsetPen(struct WM9712L *wm, int16_t x, int16_t y,
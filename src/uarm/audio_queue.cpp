@@ -1,59 +1,51 @@
 #include "audio_queue.h"
 
-#include "queue.h"
+#include <atomic>
 
-#ifndef __EMSCRIPTEN__
-    #define AUDIO_QUEUE_THREADSAFE
-#endif
-
-#ifdef AUDIO_QUEUE_THREADSAFE
-    #include <mutex>
-
-    #define AUDIO_QUEUE_LOCK std::lock_guard lock(audioQueue->mutex)
-#else
-    #define AUDIO_QUEUE_LOCK
-#endif
+#include "spsc_queue.h"
 
+// The emulation pushes samples, the audio driver pops them. Clearing is requested by the
+// producer and carried out on the consumer side, up to the samples that had been pushed at
+// the time of the request.
 struct AudioQueue {
-    Queue<uint32_t> queue;
+    SpscQueue<uint32_t> queue;
+    std::atomic<size_t> clearUntil{0};
+    std::atomic<bool> clearRequested{false};
 
     AudioQueue(size_t capacity) : queue(capacity) {}
-
-#ifdef AUDIO_QUEUE_THREADSAFE
-    std::mutex mutex;
-#endif
 };
 
+namespace {
+    void audioQueuePrvHandleClear(struct AudioQueue* audioQueue) {
+        if (audioQueue->clearRequested.load(std::memory_order_relaxed) &&
+            audioQueue->clearRequested.exchange(false, std::memory_order_acquire))
+            audioQueue->queue.DropUntil(audioQueue->clearUntil.load(std::memory_order_relaxed));
+    }
+}  // namespace
+
 struct AudioQueue* audioQueueCreate(size_t capacity) {
     AudioQueue* audioQueue = new AudioQueue(capacity);
 
     return audioQueue;
 }
 
-void audioQueuePush(struct AudioQueue* audioQueue, uint32_t sample) {
-    AUDIO_QUEUE_LOCK;
-
-    audioQueue->queue.Push(sample);
+size_t audioQueuePushChunk(struct AudioQueue* audioQueue, const uint32_t* samples, size_t count) {
+    return audioQueue->queue.PushN(samples, count);
 }
 
 size_t audioQueuePopChunk(struct AudioQueue* audioQueue, uint32_t* destination, size_t count) {
-    AUDIO_QUEUE_LOCK;
-
-    size_t actualCount = 0;
-    while (audioQueue->queue.GetSize() > 0 && actualCount < count)
-        destination[actualCount++] = audioQueue->queue.Pop();
+    audioQueuePrvHandleClear(audioQueue);
 
-    return actualCount;
+    return audioQueue->queue.PopN(destination, count);
 }
 
 size_t audioQueuePendingSamples(struct AudioQueue* audioQueue) {
-    AUDIO_QUEUE_LOCK;
+    audioQueuePrvHandleClear(audioQueue);
 
     return audioQueue->queue.GetSize();
 }
 
 void audioQueueClear(struct AudioQueue* audioQueue) {
-    AUDIO_QUEUE_LOCK;
-
-    audioQueue->queue.Clear();
+    audioQueue->clearUntil.store(audioQueue->queue.GetPushIndex(), std::memory_order_relaxed);
+    audioQueue->clearRequested.store(true, std::memory_order_release);
 }
@@ -10,9 +10,10 @@ extern "C" {
 
 struct AudioQueue;
 
+// Single producer, single consumer. Samples that do not fit are dropped.
 struct AudioQueue* audioQueueCreate(size_t capacity);
 
-void audioQueuePush(struct AudioQueue* audioQueue, uint32_t sample);
+size_t audioQueuePushChunk(struct AudioQueue* audioQueue, const uint32_t* samples, size_t count);
 
 size_t audioQueuePopChunk(struct AudioQueue* audioQueue, uint32_t* destination, size_t count);
 
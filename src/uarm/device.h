@@ -79,7 +79,8 @@ struct Device *deviceSetup(struct SocPeriphs *sp, struct Reschedule reschedule,
                            struct VSD *vsd, uint8_t *nandContent, size_t nandSize);
 void deviceKey(struct Device *dev, uint32_t key, bool down);
 void devicePeriodic(struct Device *dev, uint32_t tier);
-void devicePcmPeriodic(struct Device *dev);
+// Run nFrames AC97 frames, audio output is generated at outputHz
+void devicePcmPeriodic(struct Device *dev, uint32_t nFrames, uint32_t outputHz);
 void deviceTouch(struct Device *dev, int x, int y);
 
 void deviceGetDisplayConfiguration(struct DeviceDisplayConfiguration *displayConfiguration);
@@ -195,7 +195,9 @@ void devicePeriodic(struct Device *dev, uint32_t tier) {
     if (tier == DEVICE_PERIODIC_TIER0) directNandPeriodic(dev->nand);
 }
 
-void devicePcmPeriodic(struct Device *dev) { wm9712Lperiodic(dev->wm9712L); }
+void devicePcmPeriodic(struct Device *dev, uint32_t nFrames, uint32_t outputHz) {
+    wm9712Lperiodic(dev->wm9712L, nFrames, outputHz);
+}
 
 void deviceTouch(struct Device *dev, int x, int y) {
     wm9712LsetPen(dev->wm9712L, (x >= 0 && y >= 0) ? 280 + 173 * x / 16 : -1,
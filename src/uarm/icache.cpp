@@ -7,22 +7,36 @@
 
 #include "../util.h"
 #include "CPU.h"
+#include "peephole.h"
 #include "uarm_endian.h"
 
-#define CACHE_LINE_WIDTH_BITS 5
-#define CACHE_INDEX_BITS 17
+// Geometry can be overridden at build time. ICACHE_WAYS must be 1, 2 or 4.
+#ifndef ICACHE_SET_BITS
+    #define ICACHE_SET_BITS 15
+#endif
 
-#if (32 - CACHE_LINE_WIDTH_BITS - CACHE_INDEX_BITS <= 8)
-    #define CACHE_TAG_TYPE uint_fast8_t
-#else
-    #define CACHE_TAG_TYPE uint_fast16_t
+#ifndef ICACHE_WAYS
+    #define ICACHE_WAYS 2
 #endif
 
+#if ICACHE_WAYS != 1 && ICACHE_WAYS != 2 && ICACHE_WAYS != 4
+    #error "ICACHE_WAYS must be 1, 2 or 4"
+#endif
+
+#define CACHE_LINE_WIDTH_BITS 5
+#define CACHE_INDEX_BITS ICACHE_SET_BITS
+#define CACHE_LINES (ICACHE_WAYS << CACHE_INDEX_BITS)
+
 #define calculateIndex(va) ((va >> CACHE_LINE_WIDTH_BITS) & ~(0xffffffff << CACHE_INDEX_BITS))
 #define calculateTag(va) (va >> (CACHE_LINE_WIDTH_BITS + CACHE_INDEX_BITS))
 #define calculateLineIndex(va) (va & ~(0xffffffff << CACHE_LINE_WIDTH_BITS))
 #define maskLine(va) (va & (0xffffffff << CACHE_LINE_WIDTH_BITS))
 
+#define CODE_PAGE_SIZE (1 << RAM_BUFFER_WATCH_PAGE_BITS)
+#define CODE_PAGE_VA_ALIASED 0x01
+
+#define RAM_OFFSET_NONE 0xffffffff
+
 #ifdef __EMSCRIPTEN__
     #define DECODED_INSTRUCTION_TYPE uint16_t
     #define DECODED_BITS 0xc000
@@ -41,7 +55,12 @@ struct icacheline {
     uint8_t data[1 << CACHE_LINE_WIDTH_BITS];
     DECODED_INSTRUCTION_TYPE decoded[1 << (CACHE_LINE_WIDTH_BITS - 1)];
 
-    CACHE_TAG_TYPE tag;
+    // ARM decodes for the line if it is backed by predecoded ROM
+    const uint32_t* predecoded;
+    // Offset of the line in RAM or RAM_OFFSET_NONE
+    uint32_t ramOffset;
+
+    uint32_t tag;
     uint32_t revision;
 } __attribute__((aligned(8)));
 
@@ -49,8 +68,26 @@ struct icache {
     struct ArmMem* mem;
     struct ArmMmu* mmu;
 
+    uint32_t ramBase;
+    struct RamBuffer* ramBuffer;
+    uint32_t* codePageVa;
+
+    uint32_t romBase;
+    uint32_t romSize;
+    const uint32_t* romDecoded;
+
+#ifdef ICACHE_STATS
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t conflicts;
+#endif
+
     uint32_t revision;
-    struct icacheline cache[1 << CACHE_INDEX_BITS];
+    struct icacheline cache[CACHE_LINES];
+
+#if ICACHE_WAYS > 1
+    uint8_t mru[1 << CACHE_INDEX_BITS];
+#endif
 };
 
 void icacheInval(struct icache* ic) {
@@ -58,7 +95,7 @@ void icacheInval(struct icache* ic) {
 
     if (ic->revision == 0) {
         ic->revision = 1;
-        for (size_t i = 0; i < (1 << CACHE_INDEX_BITS); i++) ic->cache[i].revision = 0;
+        for (size_t i = 0; i < CACHE_LINES; i++) ic->cache[i].revision = 0;
     }
 }
 
@@ -78,11 +115,17 @@ struct icache* icacheInit(struct ArmMem* mem, struct ArmMmu* mmu) {
 }
 
 void icacheInvalAddr(struct icache* ic, uint32_t va) {
-    struct icacheline* line = ic->cache + calculateIndex(va);
+    struct icacheline* set = ic->cache + calculateIndex(va) * ICACHE_WAYS;
+    const uint32_t tag = calculateTag(va);
 
-    if (line->revision != ic->revision || line->tag != calculateTag(va)) return;
+    for (int way = 0; way < ICACHE_WAYS; way++) {
+        struct icacheline* line = set + way;
 
-    line->revision = ic->revision - 1;
+        if (line->revision == ic->revision && line->tag == tag) {
+            line->revision = ic->revision - 1;
+            return;
+        }
+    }
 }
 
 void icacheInvalRange(struct icache* ic, uint32_t addr, uint32_t size) {
@@ -91,6 +134,156 @@ void icacheInvalRange(struct icache* ic, uint32_t addr, uint32_t size) {
     }
 }
 
+void icacheSetCodePageTracking(struct icache* ic, uint32_t ramBase, struct RamBuffer* ramBuffer) {
+    free(ic->codePageVa);
+
+    ic->ramBase = ramBase;
+    ic->ramBuffer = ramBuffer;
+    const uint32_t nPages = ramBuffer->size >> RAM_BUFFER_WATCH_PAGE_BITS;
+    ic->codePageVa = (uint32_t*)malloc(nPages * 4);
+
+    if (!ic->codePageVa) ERR("cannot alloc code page map");
+
+    // Pages may be marked as code by other clients (PACE) without ever passing through the
+    // icache, so their mapping is unknown until we see them executed
+    for (uint32_t i = 0; i < nPages; i++) ic->codePageVa[i] = CODE_PAGE_VA_ALIASED;
+}
+
+static void icachePrvDropLine(struct icache* ic, struct icacheline* line, uint32_t page) {
+    if (line->ramOffset >> RAM_BUFFER_WATCH_PAGE_BITS != page) return;
+
+    // Decodes may depend on code beyond the line (idioms), so they have to go as well
+    memset(line->decoded, 0, sizeof(line->decoded));
+    line->revision = ic->revision - 1;
+}
+
+void icacheCodePageWritten(struct icache* ic, uint32_t ramOffset) {
+    RAM_BUFFER_CLEAR_CODE(*ic->ramBuffer, ramOffset);
+
+    const uint32_t page = ramOffset >> RAM_BUFFER_WATCH_PAGE_BITS;
+    const uint32_t va = ic->codePageVa[page];
+
+    if (va == CODE_PAGE_VA_ALIASED) {
+        for (size_t i = 0; i < CACHE_LINES; i++) icachePrvDropLine(ic, ic->cache + i, page);
+
+        return;
+    }
+
+    for (uint32_t lineVa = va; lineVa < va + CODE_PAGE_SIZE;
+         lineVa += (1 << CACHE_LINE_WIDTH_BITS)) {
+        struct icacheline* set = ic->cache + calculateIndex(lineVa) * ICACHE_WAYS;
+
+        for (int way = 0; way < ICACHE_WAYS; way++) icachePrvDropLine(ic, set + way, page);
+    }
+}
+
+void icacheSetPredecodedRom(struct icache* ic, uint32_t romBase, uint32_t romSize,
+                            const uint32_t* decoded) {
+    ic->romBase = romBase;
+    ic->romSize = romSize;
+    ic->romDecoded = decoded;
+
+    icacheInval(ic);
+}
+
+static void icachePrvTrackCodePage(struct icache* ic, uint32_t va, uint32_t ramOffset) {
+    const uint32_t vaPage = va & ~(CODE_PAGE_SIZE - 1);
+    uint32_t* codePageVa = ic->codePageVa + (ramOffset >> RAM_BUFFER_WATCH_PAGE_BITS);
+
+    if (!RAM_BUFFER_IS_CODE(*ic->ramBuffer, ramOffset)) {
+        RAM_BUFFER_MARK_CODE(*ic->ramBuffer, ramOffset);
+        *codePageVa = vaPage;
+    } else if (*codePageVa != vaPage) {
+        // the same physical page is executed through different mappings
+        *codePageVa = CODE_PAGE_VA_ALIASED;
+    }
+}
+
+void __attribute__((used)) icacheDumpStats(struct icache* ic) {  // for calling in GDB
+#ifdef ICACHE_STATS
+    const uint64_t total = ic->hits + ic->misses;
+
+    fprintf(stderr,
+            "icache: %u sets x %u ways, %lu bytes, %llu hits, %llu misses (%.2f%%), %llu "
+            "conflicts\n",
+            1u << CACHE_INDEX_BITS, ICACHE_WAYS, (unsigned long)sizeof(*ic),
+            (unsigned long long)ic->hits, (unsigned long long)ic->misses,
+            total ? 100. * ic->misses / total : 0., (unsigned long long)ic->conflicts);
+#else
+    fprintf(stderr, "icache: %u sets x %u ways, %lu bytes, build with ICACHE_STATS for counters\n",
+            1u << CACHE_INDEX_BITS, ICACHE_WAYS, (unsigned long)sizeof(*ic));
+#endif
+}
+
+static FORCE_INLINE struct icacheline* icachePrvLookup(struct icache* ic, uint32_t va) {
+    struct icacheline* set = ic->cache + calculateIndex(va) * ICACHE_WAYS;
+    const uint32_t tag = calculateTag(va);
+
+    for (int way = 0; way < ICACHE_WAYS; way++) {
+        if (set[way].revision == ic->revision && set[way].tag == tag) {
+#if ICACHE_WAYS > 1
+            ic->mru[calculateIndex(va)] = way;
+#endif
+#ifdef ICACHE_STATS
+            ic->hits++;
+#endif
+
+            return set + way;
+        }
+    }
+
+    return NULL;
+}
+
+static struct icacheline* icachePrvSelectVictim(struct icache* ic, uint32_t va) {
+    struct icacheline* set = ic->cache + calculateIndex(va) * ICACHE_WAYS;
+
+#ifdef ICACHE_STATS
+    ic->misses++;
+#endif
+
+#if ICACHE_WAYS > 1
+    const uint32_t tag = calculateTag(va);
+    int victim = -1;
+
+    // An invalidated line for the same address keeps its decoded instructions
+    for (int way = 0; way < ICACHE_WAYS && victim < 0; way++)
+        if (set[way].tag == tag) victim = way;
+
+    for (int way = 0; way < ICACHE_WAYS && victim < 0; way++)
+        if (set[way].revision != ic->revision) victim = way;
+
+    if (victim < 0) {
+    #ifdef ICACHE_STATS
+        ic->conflicts++;
+    #endif
+
+        victim = (ic->mru[calculateIndex(va)] + 1) & (ICACHE_WAYS - 1);
+    }
+
+    ic->mru[calculateIndex(va)] = victim;
+
+    return set + victim;
+#else
+    #ifdef ICACHE_STATS
+    if (set->revision == ic->revision) ic->conflicts++;
+    #endif
+
+    return set;
+#endif
+}
+
+// Code loaded into RAM may contain its own copies of routines that the ROM peephole
+// optimizer knows about. Signatures and the calls between them are only matched within the
+// 1k code page, as this is what the write tracking covers.
+static uint32_t icachePrvDecodeRamArm(struct icache* ic, uint32_t ramOffset, uint32_t inst) {
+    const uint32_t pageOffset = ramOffset & ~(CODE_PAGE_SIZE - 1);
+    const uint32_t idiom = peepholeMatch(ic->ramBuffer->buffer + (pageOffset >> 2),
+                                         (ramOffset - pageOffset) >> 2, CODE_PAGE_SIZE >> 2);
+
+    return cpuDecodeArm(idiom ? idiom : inst);
+}
+
 template <int sz>
 bool icacheFetch(struct icache* ic, uint32_t va, uint_fast8_t* fsrP, void* buf, uint32_t* decoded) {
     if (va & (sz - 1)) {  // alignment issue
@@ -99,10 +292,9 @@ bool icacheFetch(struct icache* ic, uint32_t va, uint_fast8_t* fsrP, void* buf,
         return false;
     }
 
-    struct icacheline* line = ic->cache + calculateIndex(va);
-    const uint_fast8_t tag = calculateTag(va);
+    struct icacheline* line = icachePrvLookup(ic, va);
 
-    if (line->revision != ic->revision || line->tag != tag) {
+    if (!line) {
         uint8_t data[sizeof(line->data)];
         bool cacheable = mmuIsOn(ic->mmu);
         uint32_t pa = va;
@@ -137,6 +329,18 @@ bool icacheFetch(struct icache* ic, uint32_t va, uint_fast8_t* fsrP, void* buf,
             return false;
         };
 
+        const bool inRam = ic->ramBuffer && pa - ic->ramBase < ic->ramBuffer->size;
+        if (inRam) icachePrvTrackCodePage(ic, va, pa - ic->ramBase);
+
+        line = icachePrvSelectVictim(ic, va);
+
+        const uint32_t ramOffset = inRam ? maskLine(pa) - ic->ramBase : RAM_OFFSET_NONE;
+
+        // Idiom decodes depend on the code that follows the line, so only keep them
+        // if we refill from the same location
+        if (line->ramOffset != ramOffset && line->ramOffset != RAM_OFFSET_NONE)
+            memset(line->decoded, 0, sizeof(line->decoded));
+
         for (size_t i = 0; i < sizeof(data); i += 8) {
             const uint64_t d = *(uint64_t*)(data + i);
             if ((uint32_t)d != *(uint32_t*)(line->data + i))
@@ -156,8 +360,12 @@ bool icacheFetch(struct icache* ic, uint32_t va, uint_fast8_t* fsrP, void* buf,
             *(uint64_t*)(line->data + i) = d;
         }
 
+        line->ramOffset = ramOffset;
+        line->predecoded = pa - ic->romBase < ic->romSize
+                               ? ic->romDecoded + ((maskLine(pa) - ic->romBase) >> 2)
+                               : NULL;
         line->revision = ic->revision;
-        line->tag = tag;
+        line->tag = calculateTag(va);
     }
 
     switch (sz) {
@@ -169,7 +377,13 @@ bool icacheFetch(struct icache* ic, uint32_t va, uint_fast8_t* fsrP, void* buf,
             const size_t iInst = i >> 1;
             if ((line->decoded[iInst] & DECODED_BITS) != DECODED_BITS_ARM) {
                 // fprintf(stderr, "decode cache miss ARM\n");
-                *decoded = cpuDecodeArm(inst);
+                if (line->predecoded)
+                    *decoded = line->predecoded[i >> 2];
+                else if (line->ramOffset != RAM_OFFSET_NONE)
+                    *decoded = icachePrvDecodeRamArm(ic, line->ramOffset + i, inst);
+                else
+                    *decoded = cpuDecodeArm(inst);
+
                 line->decoded[iInst] = (*decoded << DECODED_BITS_SHIFT) | DECODED_BITS_ARM;
             } else {
 #ifdef __EMSCRIPTEN__
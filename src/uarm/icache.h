@@ -9,6 +9,7 @@
 #include "CPU.h"
 #include "MMU.h"
 #include "mem.h"
+#include "ram_buffer.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,6 +24,14 @@ void icacheInval(struct icache* ic);
 void icacheInvalAddr(struct icache* ic, uint32_t addr);
 void icacheInvalRange(struct icache* ic, uint32_t addr, uint32_t size);
 
+void icacheSetCodePageTracking(struct icache* ic, uint32_t ramBase, struct RamBuffer* ramBuffer);
+void icacheCodePageWritten(struct icache* ic, uint32_t ramOffset);
+
+void icacheSetPredecodedRom(struct icache* ic, uint32_t romBase, uint32_t romSize,
+                            const uint32_t* decoded);
+
+void icacheDumpStats(struct icache* ic);
+
 #ifdef __cplusplus
 }
 
@@ -0,0 +1,227 @@
+#include "lcd_convert.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__wasm_simd128__)
+    #include <wasm_simd128.h>
+#elif defined(__SSE2__)
+    #include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) && !defined(__EMSCRIPTEN__) && (defined(__GNUC__) || defined(__clang__))
+    #define LCD_CONVERT_AVX2
+#endif
+
+static uint32_t* convertIndexed(uint32_t* dest, const uint8_t* src, uint32_t size,
+                                const uint32_t* expanded, const uint32_t pixelsPerByte) {
+    // pixelsPerByte is constant after inlining, so the copies compile to vector moves
+    for (uint32_t i = 0; i < size; i++, dest += pixelsPerByte)
+        memcpy(dest, expanded + src[i] * pixelsPerByte, pixelsPerByte * sizeof(uint32_t));
+
+    return dest;
+}
+
+static uint32_t* convert8(uint32_t* dest, const uint8_t* src, uint32_t size,
+                          const uint32_t* palette) {
+    uint32_t i = 0;
+
+    for (; i + 4 <= size; i += 4) {
+        dest[i] = palette[src[i]];
+        dest[i + 1] = palette[src[i + 1]];
+        dest[i + 2] = palette[src[i + 2]];
+        dest[i + 3] = palette[src[i + 3]];
+    }
+
+    for (; i < size; i++) dest[i] = palette[src[i]];
+
+    return dest + size;
+}
+
+#if defined(__wasm_simd128__)
+
+static uint32_t convert16Simd(uint32_t* dest, const uint8_t* src, uint32_t pixels) {
+    const v128_t mask5 = wasm_i16x8_splat(0x1f);
+    const v128_t mask6 = wasm_i16x8_splat(0x3f);
+    const v128_t alpha = wasm_i16x8_splat((int16_t)0xff00);
+    uint32_t i = 0;
+
+    for (; i + 8 <= pixels; i += 8) {
+        const v128_t v = wasm_v128_load(src + 2 * i);
+
+        const v128_t r = wasm_u16x8_shr(v, 11);
+        const v128_t g = wasm_v128_and(wasm_u16x8_shr(v, 5), mask6);
+        const v128_t b = wasm_v128_and(v, mask5);
+
+        const v128_t r8 = wasm_v128_or(wasm_i16x8_shl(r, 3), wasm_u16x8_shr(r, 2));
+        const v128_t g8 = wasm_v128_or(wasm_i16x8_shl(g, 2), wasm_u16x8_shr(g, 4));
+        const v128_t b8 = wasm_v128_or(wasm_i16x8_shl(b, 3), wasm_u16x8_shr(b, 2));
+
+        const v128_t rg = wasm_v128_or(r8, wasm_i16x8_shl(g8, 8));
+        const v128_t ba = wasm_v128_or(b8, alpha);
+
+        wasm_v128_store(dest + i, wasm_i16x8_shuffle(rg, ba, 0, 8, 1, 9, 2, 10, 3, 11));
+        wasm_v128_store(dest + i + 4, wasm_i16x8_shuffle(rg, ba, 4, 12, 5, 13, 6, 14, 7, 15));
+    }
+
+    return i;
+}
+
+#elif defined(__SSE2__)
+
+static uint32_t convert16Simd(uint32_t* dest, const uint8_t* src, uint32_t pixels) {
+    const __m128i mask5 = _mm_set1_epi16(0x1f);
+    const __m128i mask6 = _mm_set1_epi16(0x3f);
+    const __m128i alpha = _mm_set1_epi16((short)0xff00);
+    uint32_t i = 0;
+
+    for (; i + 8 <= pixels; i += 8) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(src + 2 * i));
+
+        const __m128i r = _mm_srli_epi16(v, 11);
+        const __m128i g = _mm_and_si128(_mm_srli_epi16(v, 5), mask6);
+        const __m128i b = _mm_and_si128(v, mask5);
+
+        const __m128i r8 = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+        const __m128i g8 = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+        const __m128i b8 = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+
+        const __m128i rg = _mm_or_si128(r8, _mm_slli_epi16(g8, 8));
+        const __m128i ba = _mm_or_si128(b8, alpha);
+
+        _mm_storeu_si128((__m128i*)(dest + i), _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128((__m128i*)(dest + i + 4), _mm_unpackhi_epi16(rg, ba));
+    }
+
+    return i;
+}
+
+#else
+
+static uint32_t convert16Simd(uint32_t* dest, const uint8_t* src, uint32_t pixels) { return 0; }
+
+#endif
+
+#ifdef LCD_CONVERT_AVX2
+
+__attribute__((target("avx2"))) static uint32_t convert16Avx2(uint32_t* dest,
+                                                              const uint8_t* src,
+                                                              uint32_t pixels) {
+    const __m256i mask5 = _mm256_set1_epi16(0x1f);
+    const __m256i mask6 = _mm256_set1_epi16(0x3f);
+    const __m256i alpha = _mm256_set1_epi16((short)0xff00);
+    uint32_t i = 0;
+
+    for (; i + 16 <= pixels; i += 16) {
+        const __m256i v = _mm256_loadu_si256((const __m256i*)(src + 2 * i));
+
+        const __m256i r = _mm256_srli_epi16(v, 11);
+        const __m256i g = _mm256_and_si256(_mm256_srli_epi16(v, 5), mask6);
+        const __m256i b = _mm256_and_si256(v, mask5);
+
+        const __m256i r8 = _mm256_or_si256(_mm256_slli_epi16(r, 3), _mm256_srli_epi16(r, 2));
+        const __m256i g8 = _mm256_or_si256(_mm256_slli_epi16(g, 2), _mm256_srli_epi16(g, 4));
+        const __m256i b8 = _mm256_or_si256(_mm256_slli_epi16(b, 3), _mm256_srli_epi16(b, 2));
+
+        const __m256i rg = _mm256_or_si256(r8, _mm256_slli_epi16(g8, 8));
+        const __m256i ba = _mm256_or_si256(b8, alpha);
+
+        // unpack works within 128 bit lanes, so the halves need to be reordered
+        const __m256i lo = _mm256_unpacklo_epi16(rg, ba);
+        const __m256i hi = _mm256_unpackhi_epi16(rg, ba);
+
+        _mm256_storeu_si256((__m256i*)(dest + i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*)(dest + i + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+
+    return i;
+}
+
+#endif
+
+static uint32_t* convert16(uint32_t* dest, const uint8_t* src, uint32_t size) {
+    const uint32_t pixels = size >> 1;
+    uint32_t i = 0;
+
+#ifdef LCD_CONVERT_AVX2
+    static int haveAvx2 = -1;
+    if (haveAvx2 < 0) haveAvx2 = __builtin_cpu_supports("avx2");
+
+    if (haveAvx2) i = convert16Avx2(dest, src, pixels);
+#endif
+
+    i += convert16Simd(dest + i, src + 2 * i, pixels - i);
+
+    for (; i < pixels; i++) {
+        uint16_t rgb16;
+        memcpy(&rgb16, src + 2 * i, sizeof(rgb16));
+
+        dest[i] = lcdUnpackRgb565(rgb16);
+    }
+
+    return dest + pixels;
+}
+
+void lcdExpandPalette(uint32_t* expanded, const uint32_t* palette, uint8_t bpp) {
+    if (bpp > 2) return;
+
+    const uint32_t pixelsPerByte = 8 >> bpp;
+    const uint32_t bitsPerPixel = 1 << bpp;
+    const uint32_t mask = (1 << bitsPerPixel) - 1;
+
+    for (uint32_t byte = 0; byte < 256; byte++)
+        for (uint32_t i = 0; i < pixelsPerByte; i++)
+            expanded[byte * pixelsPerByte + i] = palette[(byte >> (i * bitsPerPixel)) & mask];
+}
+
+uint8_t* lcdConvertToIndexed8(uint8_t* dest, const uint8_t* src, uint32_t size, uint8_t bpp) {
+    static uint8_t indices[3][256][8];
+    static bool initialized = false;
+
+    if (bpp == 3) {
+        memcpy(dest, src, size);
+        return dest + size;
+    }
+
+    if (bpp > 3) return dest;
+
+    if (!initialized) {
+        for (uint32_t depth = 0; depth < 3; depth++)
+            for (uint32_t byte = 0; byte < 256; byte++)
+                for (uint32_t i = 0; i < (8u >> depth); i++)
+                    indices[depth][byte][i] =
+                        (byte >> (i << depth)) & ((1 << (1 << depth)) - 1);
+
+        initialized = true;
+    }
+
+    const uint32_t pixelsPerByte = 8 >> bpp;
+
+    for (uint32_t i = 0; i < size; i++, dest += pixelsPerByte)
+        memcpy(dest, indices[bpp][src[i]], pixelsPerByte);
+
+    return dest;
+}
+
+uint32_t* lcdConvert(uint32_t* dest, const uint8_t* src, uint32_t size, uint8_t bpp,
+                     const uint32_t* palette, const uint32_t* expanded) {
+    switch (bpp) {
+        case 0:
+            return convertIndexed(dest, src, size, expanded, 8);
+
+        case 1:
+            return convertIndexed(dest, src, size, expanded, 4);
+
+        case 2:
+            return convertIndexed(dest, src, size, expanded, 2);
+
+        case 3:
+            return convert8(dest, src, size, palette);
+
+        case 4:
+            return convert16(dest, src, size);
+
+        default:
+            return dest;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef _LCD_CONVERT_H_
+#define _LCD_CONVERT_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pixel format conversion from guest framebuffer layouts to host ABGR8888. bpp is encoded
+// as in LCCR3: 0 = 1bpp, 1 = 2bpp, 2 = 4bpp, 3 = 8bpp, 4 = 16bpp (RGB565).
+
+#define LCD_EXPANDED_PALETTE_SIZE (256 * 8)
+
+static inline uint32_t lcdUnpackRgb565(uint16_t rgb16) {
+    uint8_t r = (rgb16 >> 11) & 0x1f;
+    uint8_t g = (rgb16 >> 5) & 0x3f;
+    uint8_t b = (rgb16 >> 0) & 0x1f;
+
+    r = (r << 3) | (r >> 2);
+    g = (g << 2) | (g >> 4);
+    b = (b << 3) | (b >> 2);
+
+    return 0xff000000 | (b << 16) | (g << 8) | r;
+}
+
+// Precompute the pixels for every possible source byte in 1, 2 and 4 bpp modes.
+// expanded must hold LCD_EXPANDED_PALETTE_SIZE entries.
+void lcdExpandPalette(uint32_t* expanded, const uint32_t* palette, uint8_t bpp);
+
+// Convert size bytes of framebuffer data, returns the end of the converted pixels in dest.
+// expanded must have been prepared by lcdExpandPalette for the same bpp if bpp < 3.
+uint32_t* lcdConvert(uint32_t* dest, const uint8_t* src, uint32_t size, uint8_t bpp,
+                     const uint32_t* palette, const uint32_t* expanded);
+
+// Unpack size bytes of 1, 2, 4 or 8 bpp framebuffer data to one palette index per byte.
+uint8_t* lcdConvertToIndexed8(uint8_t* dest, const uint8_t* src, uint32_t size, uint8_t bpp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _LCD_CONVERT_H_
@@ -136,3 +136,17 @@ bool memInstructionFetch(struct ArmMem *mem, uint32_t addr, uint_fast8_t size, v
 
     return ret;
 }
+
+bool memGetHostPage(struct ArmMem *mem, uint32_t pa, bool write, struct MemHostPage *page) {
+    pa &= ~(MEM_HOST_PAGE_SIZE - 1);
+
+    if (mem->regions[REGION_RAM].pa <= pa &&
+        mem->regions[REGION_RAM].pa + mem->regions[REGION_RAM].sz >= pa + MEM_HOST_PAGE_SIZE)
+        return ramGetHostPage(mem->regions[REGION_RAM].uD, pa, write, page);
+
+    if (mem->regions[REGION_ROM].pa <= pa &&
+        mem->regions[REGION_ROM].pa + mem->regions[REGION_ROM].sz >= pa + MEM_HOST_PAGE_SIZE)
+        return !write && romGetHostPage(mem->regions[REGION_ROM].uD, pa, page);
+
+    return false;
+}
@@ -12,6 +12,21 @@ extern "C" {
 
 struct ArmMem;
 
+#define MEM_HOST_PAGE_SIZE 1024
+
+// Host memory that backs a page of the primary RAM or ROM region. Writes are only possible
+// to RAM. A writer must set dirtyMask in *dirtyWord and must go through memAccess instead if
+// watchMask is set in *watchWord. watchReasons is the RAM_BUFFER_WATCH_* set for the page.
+struct MemHostPage {
+    uint8_t* host;
+
+    uint32_t* dirtyWord;
+    uint32_t dirtyMask;
+    uint32_t* watchWord;
+    uint32_t watchMask;
+    uint8_t* watchReasons;
+};
+
 typedef bool (*ArmMemAccessF)(void* userData, uint32_t pa, uint_fast8_t size, bool write,
                               void* buf);
 
@@ -26,6 +41,8 @@ bool memAccess(struct ArmMem* mem, uint32_t addr, uint_fast8_t size, bool write,
 
 bool memInstructionFetch(struct ArmMem* mem, uint32_t addr, uint_fast8_t size, void* buf);
 
+bool memGetHostPage(struct ArmMem* mem, uint32_t pa, bool write, struct MemHostPage* page);
+
 #ifdef __cplusplus
 }
 #endif
@@ -54,7 +54,7 @@ namespace {
                                       reinterpret_cast<unsigned long>(host) | 0x08);
 
         while (size > 0) {
-            MMUTranslateResult translateResult = mmuTranslate(mmu, arm, privileged, false);
+            MMUTranslateResult translateResult = mmuTranslate(mmu, arm, privileged, write);
             if (!MMU_TRANSLATE_RESULT_OK(translateResult)) {
                 result->ok = false;
                 result->fsr = MMU_TRANSLATE_RESULT_FSR(translateResult);
@@ -111,6 +111,27 @@ void memcpy_hostToArm(uint32_t dest, uint8_t* src, uint32_t size, bool privilege
     transfer(src, dest, size, true, privileged, mem, mmu, result);
 }
 
+bool memcpy_probe(uint32_t arm, uint32_t size, bool write, bool privileged, struct ArmMem* mem,
+                  struct ArmMmu* mmu) {
+    if (size == 0) return true;
+
+    const uint32_t last = arm + size - 1;
+    if (last < arm) return false;
+
+    for (uint32_t page = arm & ~0x03ff;; page += 0x0400) {
+        const uint32_t va = page < arm ? arm : page;
+
+        MMUTranslateResult translateResult = mmuTranslate(mmu, va, privileged, write);
+        if (!MMU_TRANSLATE_RESULT_OK(translateResult)) return false;
+
+        MemHostPage hostPage;
+        if (!memGetHostPage(mem, MMU_TRANSLATE_RESULT_PA(translateResult), write, &hostPage))
+            return false;
+
+        if ((last & ~0x03ff) == page) return true;
+    }
+}
+
 void memcpy_armToArm(uint32_t dest, uint32_t src, uint32_t size, bool privileged,
                      struct ArmMem* mem, struct ArmMmu* mmu, struct MemcpyResult* result) {
     static uint64_t scratch[512];
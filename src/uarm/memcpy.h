@@ -26,6 +26,11 @@ void memcpy_hostToArm(uint32_t dest, uint8_t* src, uint32_t size, bool privilege
 void memcpy_armToArm(uint32_t dest, uint32_t src, uint32_t size, bool privileged,
                      struct ArmMem* mem, struct ArmMmu* mmu, struct MemcpyResult* result);
 
+// Checks that a transfer would succeed without touching memory. Only RAM and ROM pages
+// qualify.
+bool memcpy_probe(uint32_t arm, uint32_t size, bool write, bool privileged, struct ArmMem* mem,
+                  struct ArmMmu* mmu);
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,8 +4,11 @@
 
 #include "mem.h"
 #include "memcpy.h"
+#include "pace_traps.h"
+#include "ram_buffer.h"
 #include "uae/UAE.h"
 #include "uarm_endian.h"
+#include "util.h"
 
 #ifdef __EMSCRIPTEN__
     #include <emscripten.h>
@@ -22,11 +25,251 @@ static uint32_t pendingStatus = 0;
 static uint32_t statePtr;
 static bool priviledged = false;
 
+// Direct mapped VA -> host pointer cache for RAM and ROM pages. Entries are filled by the
+// slow path and dropped whenever the MMU flushes its TLB. Write pointers are also dropped
+// when a DACR change takes write access away.
+#define HOST_PAGE_BITS 10
+#define HOST_PAGE_CACHE_SIZE 512
+#define HOST_PAGE_TAG_INVALID 0xffffffff
+
+struct HostPageEntry {
+    uint32_t tag;
+
+    uint8_t* read;
+    uint8_t* write;
+
+    uint32_t* dirtyWord;
+    uint32_t dirtyMask;
+    const uint32_t* watchWord;
+    uint32_t watchMask;
+};
+
+static struct HostPageEntry hostPages[HOST_PAGE_CACHE_SIZE];
+static uint32_t mmuGeneration;
+static uint32_t mmuPermissionGeneration;
+
+// Direct mapped cache of decoded blocks, keyed by 68k PC. A block is recorded while it is
+// interpreted for the first time and ends at the first instruction that does not fall
+// through, at a page boundary or after BLOCK_MAX_INSTRUCTIONS. Replaying a block calls the
+// recorded handlers back to back and bails out as soon as the PC leaves the recorded path.
+// RAM pages that hold blocks are flagged as code pages, writes to them are reported through
+// paceCodePageWritten.
+#define BLOCK_CACHE_SIZE 1024
+#define BLOCK_MAX_INSTRUCTIONS 16
+#define DECODE_PC_INVALID 0x01
+#define CODE_PAGE_NONE 0xffffffff
+
+struct PaceBlock {
+    uint32_t pc;
+    uint32_t codePage;
+    uint32_t nInstructions;
+
+    struct PaceDecodedInstruction instructions[BLOCK_MAX_INSTRUCTIONS];
+};
+
+static struct PaceBlock blockCache[BLOCK_CACHE_SIZE];
+static const struct PaceDecodedInstruction noInstruction = {.pc = DECODE_PC_INVALID, .size = 0};
+static uint32_t ramBase;
+
+const struct PaceDecodedInstruction* paceCurrentInstruction = &noInstruction;
+
 #ifdef __EMSCRIPTEN__
 static cpuop_func* cpufunctbl_base;
+#endif
+
+static FORCE_INLINE struct HostPageEntry* hostPageEntry(uint32_t addr) {
+    return &hostPages[(addr >> HOST_PAGE_BITS) & (HOST_PAGE_CACHE_SIZE - 1)];
+}
+
+static FORCE_INLINE uint8_t* hostPageRead(uint32_t addr) {
+    const struct HostPageEntry* entry = hostPageEntry(addr);
+
+    return entry->tag == (addr >> HOST_PAGE_BITS) && fsr == 0
+               ? entry->read + (addr & ((1 << HOST_PAGE_BITS) - 1))
+               : NULL;
+}
+
+static FORCE_INLINE uint8_t* hostPageWrite(uint32_t addr) {
+    const struct HostPageEntry* entry = hostPageEntry(addr);
+
+    if (entry->tag != (addr >> HOST_PAGE_BITS) || !entry->write || fsr != 0 ||
+        *entry->watchWord & entry->watchMask)
+        return NULL;
+
+    *entry->dirtyWord |= entry->dirtyMask;
+
+    return entry->write + (addr & ((1 << HOST_PAGE_BITS) - 1));
+}
+
+static void hostPageFill(uint32_t addr, uint32_t pa, bool write) {
+    struct MemHostPage page;
+    if (!memGetHostPage(mem, pa, write, &page)) return;
+
+    struct HostPageEntry* entry = hostPageEntry(addr);
+    const uint32_t tag = addr >> HOST_PAGE_BITS;
+
+    if (entry->tag != tag) {
+        memset(entry, 0, sizeof(*entry));
+        entry->tag = tag;
+    }
+
+    entry->read = page.host;
+
+    if (write) {
+        entry->write = page.host;
+        entry->dirtyWord = page.dirtyWord;
+        entry->dirtyMask = page.dirtyMask;
+        entry->watchWord = page.watchWord;
+        entry->watchMask = page.watchMask;
+    }
+}
+
+void paceInvalidateHostPages() {
+    for (size_t i = 0; i < HOST_PAGE_CACHE_SIZE; i++) hostPages[i].tag = HOST_PAGE_TAG_INVALID;
+}
+
+static void invalidateBlock(struct PaceBlock* block) {
+    // the block may be invalidated by a write from one of its own instructions
+    if (paceCurrentInstruction >= block->instructions &&
+        paceCurrentInstruction < block->instructions + BLOCK_MAX_INSTRUCTIONS)
+        paceCurrentInstruction = &noInstruction;
+
+    block->pc = DECODE_PC_INVALID;
+    block->nInstructions = 0;
+}
+
+static void invalidateTranslations() {
+    paceInvalidateHostPages();
+    for (size_t i = 0; i < BLOCK_CACHE_SIZE; i++) invalidateBlock(blockCache + i);
+
+    mmuGeneration = mmuGetGeneration(mmu);
+    mmuPermissionGeneration = mmuGetPermissionGeneration(mmu);
+}
+
+static void revokeHostPageWrites() {
+    for (size_t i = 0; i < HOST_PAGE_CACHE_SIZE; i++) hostPages[i].write = NULL;
+
+    mmuPermissionGeneration = mmuGetPermissionGeneration(mmu);
+}
+
+void paceSetCodePageTracking(uint32_t _ramBase) { ramBase = _ramBase; }
+
+void paceCodePageWritten(uint32_t ramOffset) {
+    const uint32_t codePage = ramOffset >> RAM_BUFFER_WATCH_PAGE_BITS;
+
+    for (size_t i = 0; i < BLOCK_CACHE_SIZE; i++)
+        if (blockCache[i].codePage == codePage) invalidateBlock(blockCache + i);
+}
+
+static bool decodeInstruction(struct PaceDecodedInstruction* entry, uint32_t pc) {
+    if (pc & 0x01) return false;
+
+    MMUTranslateResult translateResult = mmuTranslate(mmu, pc, priviledged, false);
+    if (!MMU_TRANSLATE_RESULT_OK(translateResult)) return false;
+
+    const uint32_t pa = MMU_TRANSLATE_RESULT_PA(translateResult);
+
+    struct MemHostPage page;
+    if (!memGetHostPage(mem, pa, false, &page)) return false;
+
+    // do not prefetch across the page boundary, the next page might not be mapped
+    const uint32_t pageOffset = pa & (MEM_HOST_PAGE_SIZE - 1);
+    uint32_t size = MEM_HOST_PAGE_SIZE - pageOffset;
+    if (size > 2 * PACE_DECODE_WINDOW_WORDS) size = 2 * PACE_DECODE_WINDOW_WORDS;
+
+    const uint8_t* host = page.host + pageOffset;
+    for (uint32_t i = 0; i < size / 2; i++) entry->words[i] = (host[2 * i] << 8) | host[2 * i + 1];
+
+    if (page.watchWord) {
+        *page.watchReasons |= RAM_BUFFER_WATCH_CODE;
+        *page.watchWord |= page.watchMask;
+        entry->codePage = (pa - ramBase) >> RAM_BUFFER_WATCH_PAGE_BITS;
+    } else {
+        entry->codePage = CODE_PAGE_NONE;
+    }
+
+#ifdef __EMSCRIPTEN__
+    entry->handler = (cpuop_func*)((long)cpufunctbl_base + entry->words[0]);
+#else
+    entry->handler = cpufunctbl[entry->words[0]];
+#endif
+
+    entry->size = size;
+    entry->pc = pc;
+
+    return true;
+}
+
+static FORCE_INLINE uint32_t executeDecoded(const struct PaceDecodedInstruction* instruction) {
+    paceCurrentInstruction = instruction;
+    regs.lastOpcode = instruction->words[0];
+
+    return instruction->handler(instruction->words[0]);
+}
+
+static uint32_t executeUncached() {
+    paceCurrentInstruction = &noInstruction;
+
+    uint16_t opcode = uae_get16(regs.pc);
+    regs.lastOpcode = opcode;
+
+    if (fsr != 0) return 0;
+
+        // fprintf(stderr, "execute m68k opcode %#06x at %#010x\n", opcode, regs.pc);
+
+#ifdef __EMSCRIPTEN__
+    return ((cpuop_func*)((long)cpufunctbl_base + opcode))(opcode);
 #else
-static cpuop_func* cpufunctbl[65536];  // (normally in newcpu.c)
+    return cpufunctbl[opcode](opcode);
 #endif
+}
+
+static uint32_t replayBlock(const struct PaceBlock* block, uint32_t* instructions) {
+    uint32_t cycles = 0;
+
+    for (uint32_t i = 0; i < block->nInstructions; i++) {
+        const struct PaceDecodedInstruction* instruction = block->instructions + i;
+        if (regs.pc != instruction->pc) break;
+
+        cycles += executeDecoded(instruction);
+        (*instructions)++;
+
+        if (fsr != 0 || pendingStatus != pace_status_ok) break;
+    }
+
+    return cycles;
+}
+
+static uint32_t recordBlock(struct PaceBlock* block, uint32_t* instructions) {
+    const uint32_t page = regs.pc & ~(MEM_HOST_PAGE_SIZE - 1);
+    uint32_t cycles = 0;
+
+    block->pc = regs.pc;
+    block->nInstructions = 0;
+    block->codePage = CODE_PAGE_NONE;
+
+    while (block->nInstructions < BLOCK_MAX_INSTRUCTIONS) {
+        struct PaceDecodedInstruction* instruction = block->instructions + block->nInstructions;
+        const uint32_t pc = regs.pc;
+
+        if ((pc & ~(MEM_HOST_PAGE_SIZE - 1)) != page || !decodeInstruction(instruction, pc)) break;
+        block->codePage = instruction->codePage;
+
+        cycles += executeDecoded(instruction);
+        (*instructions)++;
+
+        // a store to the block's own page invalidates it
+        if (fsr != 0 || block->pc == DECODE_PC_INVALID) break;
+        block->nInstructions++;
+
+        if (pendingStatus != pace_status_ok) break;
+        if (regs.pc <= pc || regs.pc - pc > 2 * PACE_DECODE_WINDOW_WORDS) break;
+    }
+
+    if (block->nInstructions == 0) invalidateBlock(block);
+
+    return cycles;
+}
 
 static uint32_t pace_get_le(uint32_t addr, uint8_t size) {
     if (fsr != 0) return 0;
@@ -42,6 +285,7 @@ static uint32_t pace_get_le(uint32_t addr, uint8_t size) {
     }
 
     const uint32_t pa = MMU_TRANSLATE_RESULT_PA(translateResult);
+    hostPageFill(addr, pa, false);
 
     uint32_t result = 0;
     bool ok = memAccess(mem, pa, size, false, &result);
@@ -54,7 +298,11 @@ static uint32_t pace_get_le(uint32_t addr, uint8_t size) {
     return result;
 }
 
-uint8_t uae_get8(uint32_t addr) { return pace_get_le(addr, 1); }
+uint8_t uae_get8(uint32_t addr) {
+    const uint8_t* host = hostPageRead(addr);
+
+    return host ? *host : pace_get_le(addr, 1);
+}
 
 uint16_t uae_get16(uint32_t addr) {
     if (!fsr && addr & 0x01) {
@@ -62,6 +310,9 @@ uint16_t uae_get16(uint32_t addr) {
         return 0;
     }
 
+    const uint8_t* host = hostPageRead(addr);
+    if (host) return (host[0] << 8) | host[1];
+
     return htobe16(pace_get_le(addr, 2));
 }
 
@@ -101,6 +352,13 @@ static uint32_t uae_get32_split(uint32_t addr) {
 }
 
 uint32_t uae_get32(uint32_t addr) {
+    const uint8_t* host;
+
+    // half word aligned accesses may cross into the next page
+    if ((addr & 0x01) == 0 && (addr & ((1 << HOST_PAGE_BITS) - 1)) <= (1 << HOST_PAGE_BITS) - 4 &&
+        (host = hostPageRead(addr)))
+        return ((uint32_t)host[0] << 24) | ((uint32_t)host[1] << 16) | (host[2] << 8) | host[3];
+
     switch (__builtin_ctz(addr)) {
         case 0:
             fsr = 1;
@@ -132,6 +390,7 @@ static void pace_put_le(uint32_t addr, uint32_t value, uint8_t size) {
     }
 
     uint32_t pa = MMU_TRANSLATE_RESULT_PA(translateResult);
+    hostPageFill(addr, pa, true);
 
     bool ok = memAccess(mem, pa, size, true, &value);
 
@@ -140,7 +399,14 @@ static void pace_put_le(uint32_t addr, uint32_t value, uint8_t size) {
     }
 }
 
-void uae_put8(uint32_t addr, uint8_t value) { pace_put_le(addr, value, 1); };
+void uae_put8(uint32_t addr, uint8_t value) {
+    uint8_t* host = hostPageWrite(addr);
+
+    if (host)
+        *host = value;
+    else
+        pace_put_le(addr, value, 1);
+}
 
 void uae_put16(uint32_t addr, uint16_t value) {
     if (!fsr && addr & 0x01) {
@@ -148,6 +414,14 @@ void uae_put16(uint32_t addr, uint16_t value) {
         return;
     }
 
+    uint8_t* host = hostPageWrite(addr);
+    if (host) {
+        host[0] = value >> 8;
+        host[1] = value;
+
+        return;
+    }
+
     pace_put_le(addr, be16toh(value), 2);
 }
 
@@ -160,7 +434,7 @@ static void uae_put32_split(uint32_t addr, uint32_t value) {
         lastAddr = addr;
         wasWrite = true;
 
-        MMUTranslateResult translateResult = mmuTranslate(mmu, addr, priviledged, false);
+        MMUTranslateResult translateResult = mmuTranslate(mmu, addr, priviledged, true);
 
         if (!MMU_TRANSLATE_RESULT_OK(translateResult)) {
             fsr = MMU_TRANSLATE_RESULT_FSR(translateResult);
@@ -184,6 +458,18 @@ static void uae_put32_split(uint32_t addr, uint32_t value) {
 }
 
 void uae_put32(uint32_t addr, uint32_t value) {
+    uint8_t* host;
+
+    if ((addr & 0x01) == 0 && (addr & ((1 << HOST_PAGE_BITS) - 1)) <= (1 << HOST_PAGE_BITS) - 4 &&
+        (host = hostPageWrite(addr))) {
+        host[0] = value >> 24;
+        host[1] = value >> 16;
+        host[2] = value >> 8;
+        host[3] = value;
+
+        return;
+    }
+
     switch (__builtin_ctz(addr)) {
         case 0:
             fsr = 1;
@@ -237,66 +523,12 @@ unsigned long op_line1010(uint32_t opcode) REGPARAM {
 void notifiyReturn() { pendingStatus = pace_status_return; }
 
 static void staticInit() {
+#ifdef __EMSCRIPTEN__
     static bool initialized = false;
     if (initialized) return;
 
-    int i, j;
-    for (i = 0; i < 256; i++) {
-        for (j = 0; j < 8; j++) {
-            if (i & (1 << j)) {
-                break;
-            }
-        }
-
-        movem_index1[i] = j;
-        movem_index2[i] = 7 - j;
-        movem_next[i] = i & (~(1 << j));
-    }
-
-    read_table68k();
-    do_merges();
-
-    // The rest of this code is based on build_cpufunctbl in newcpu.c.
-
-#ifdef __EMSCRIPTEN__
-    cpuop_func** cpufunctbl =
-        (cpuop_func**)malloc(0x10000 * sizeof(cpuop_func*));  // (normally in newcpu.c)
-#endif
-
-    unsigned long opcode;
-    struct cputbl* tbl = op_smalltbl_3;
-
-    for (opcode = 0; opcode < 65536; opcode++) {
-        if (opcode >> 12 == 0x0f)
-            cpufunctbl[opcode] = op_line1111;
-        else if (opcode >> 12 == 0x0a)
-            cpufunctbl[opcode] = op_line1010;
-        else
-            cpufunctbl[opcode] = op_illg;
-    }
-
-    for (i = 0; tbl[i].handler != NULL; i++)
-        if (!tbl[i].specific) cpufunctbl[tbl[i].opcode] = tbl[i].handler;
-
-    for (opcode = 0; opcode < 65536; opcode++) {
-        cpuop_func* f;
-
-        if (table68k[opcode].mnemo == i_ILLG || table68k[opcode].clev > 0) continue;
-
-        if (table68k[opcode].handler != -1) {
-            f = cpufunctbl[table68k[opcode].handler];
-            if (f == op_illg) {
-                abort();
-            }
-
-            cpufunctbl[opcode] = f;
-        }
-    }
-
-    for (i = 0; tbl[i].handler != NULL; i++)
-        if (tbl[i].specific) cpufunctbl[tbl[i].opcode] = tbl[i].handler;
-
-#ifdef __EMSCRIPTEN__
+    // The opcode tables are generated at build time (see gencpufunctbl.c). We only need to
+    // copy the handlers to a contiguous range of the function table.
     cpufunctbl_base = (cpuop_func*)EM_ASM_INT(
         {
             wasmTable.grow(0x10000);
@@ -309,13 +541,8 @@ static void staticInit() {
         },
         cpufunctbl);
 
-    free(cpufunctbl);
-#endif
-
-    // (hey readcpu doesn't free this guy!)
-    free(table68k);
-
     initialized = true;
+#endif
 }
 
 void paceInit(struct ArmMem* _mem, struct ArmMmu* _mmu) {
@@ -323,6 +550,9 @@ void paceInit(struct ArmMem* _mem, struct ArmMmu* _mmu) {
 
     mem = _mem;
     mmu = _mmu;
+
+    invalidateTranslations();
+    paceNativeTrapsReset();
 }
 
 void paceSetStatePtr(uint32_t addr) { statePtr = addr; }
@@ -331,6 +561,8 @@ uint8_t paceGetFsr() { return fsr; }
 
 uint16_t paceGetLastOpcode() { return regs.lastOpcode; }
 
+uint32_t paceGetPc() { return m68k_getpc(); }
+
 bool paceLoad68kState() {
     static uint32_t stateScratchBuffer[19];
 
@@ -405,27 +637,58 @@ uint16_t paceReadTrapWord() {
     return uae_get16(regs.pc - 2);
 }
 
-void paceSetPriviledged(bool _priviledged) { priviledged = _priviledged; }
+void paceSetPriviledged(bool _priviledged) {
+    if (_priviledged != priviledged) invalidateTranslations();
+
+    priviledged = _priviledged;
+}
+
+enum paceStatus paceExecute(uint32_t maxCycles, uint32_t* cyclesExecuted) {
+    uint32_t cycles = 0;
 
-enum paceStatus paceExecute() {
     fsr = 0;
     pendingStatus = pace_status_ok;
 
-    uint16_t opcode = uae_get16(regs.pc);
-    regs.lastOpcode = opcode;
+    if (mmuGeneration != mmuGetGeneration(mmu)) invalidateTranslations();
+    if (mmuPermissionGeneration != mmuGetPermissionGeneration(mmu)) revokeHostPageWrites();
 
-    if (fsr != 0) return pace_status_memory_fault;
+    paceNativeTrapResumed();
 
-        // fprintf(stderr, "execute m68k opcode %#06x at %#010x\n", opcode, regs.pc);
+    uint32_t instructions = 0;
 
-#ifdef __EMSCRIPTEN__
-    ((cpuop_func*)((long)cpufunctbl_base + opcode))(opcode);
-#else
-    cpufunctbl[opcode](opcode);
-#endif
+    while (instructions < PACE_MAX_BATCH && cycles < maxCycles) {
+        struct PaceBlock* block = &blockCache[(regs.pc >> 1) & (BLOCK_CACHE_SIZE - 1)];
+
+        if (block->pc == regs.pc) {
+            cycles += replayBlock(block, &instructions);
+        } else {
+            const uint32_t instructionsBefore = instructions;
+            cycles += recordBlock(block, &instructions);
+
+            if (instructions == instructionsBefore) {
+                cycles += executeUncached();
+                instructions++;
+            }
+        }
+
+        //    fprintf(stderr, "a7 now %#010x, top of stack is %#010x\n", m68k_areg(regs, 7),
+        //            uae_get32(m68k_areg(regs, 7)));
+
+        if (pendingStatus == pace_status_syscall && fsr == 0) {
+            const uint16_t trapWord = uae_get16(regs.pc - 2);
+            uint32_t trapCycles;
+
+            if (fsr == 0 && paceNativeTrap(trapWord, &trapCycles)) {
+                pendingStatus = pace_status_ok;
+                cycles += trapCycles;
+            }
+        }
+
+        if (fsr != 0 || pendingStatus != pace_status_ok) break;
+    }
 
-    //    fprintf(stderr, "a7 now %#010x, top of stack is %#010x\n", m68k_areg(regs, 7),
-    //            uae_get32(m68k_areg(regs, 7)));
+    paceCurrentInstruction = &noInstruction;
+    *cyclesExecuted = cycles > 0 ? cycles : 1;
 
     return fsr == 0 ? pendingStatus : pace_status_memory_fault;
 }
@@ -11,6 +11,10 @@
 extern "C" {
 #endif
 
+// Upper bound for the number of instructions per paceExecute call. Keeps interrupt latency
+// in check if the 68k code raises an IRQ through MMIO.
+#define PACE_MAX_BATCH 256
+
 enum paceStatus {
     pace_status_ok = 0,
     pace_status_illegal_instr = 4,
@@ -31,8 +35,15 @@ void paceInit(struct ArmMem* mem, struct ArmMmu* mmu);
 void paceSetStatePtr(uint32_t addr);
 uint8_t paceGetFsr();
 uint16_t paceGetLastOpcode();
+uint32_t paceGetPc();
 
 void paceSetPriviledged(bool priviledged);
+// Drop cached host pointers, required if the memory layout changes outside the MMU (e.g.
+// framebuffer relocation)
+void paceInvalidateHostPages();
+
+void paceSetCodePageTracking(uint32_t ramBase);
+void paceCodePageWritten(uint32_t ramOffset);
 
 bool paceLoad68kState();
 bool paceSave68kState();
@@ -40,7 +51,9 @@ bool paceSave68kState();
 void paceGetMemeryFault(uint32_t* addr, bool* wasWrite, uint_fast8_t* fsr);
 uint16_t paceReadTrapWord();
 
-enum paceStatus paceExecute();
+// Run 68k instructions until maxCycles (68k cycles) are used up or a status other than
+// pace_status_ok is raised.
+enum paceStatus paceExecute(uint32_t maxCycles, uint32_t* cyclesExecuted);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,259 @@
+#include "pace_traps.h"
+
+#include <string.h>
+
+#include "pace.h"
+#include "uae/UAE.h"
+
+// Only traps that are pure functions of 68k memory are implemented here. Arguments are
+// passed on the 68k stack, results are returned in D0 (integers) or A0 (pointers). Memory
+// faults are reported through the regular PACE fault path.
+//
+// A trap only takes the native path as long as its dispatch table entry still points to the
+// ROM implementation. We cannot read the table itself, so we watch the 68k
+// SysSetTrapAddress / SysGetTrapAddress traps instead: the first SysGetTrapAddress on an
+// unpatched trap tells us the ROM address, and any SysSetTrapAddress to a different (or
+// unknown) address disables the native path until the ROM address is restored.
+
+#define SYS_TRAP_MEM_MOVE 0xa026
+#define SYS_TRAP_MEM_SET 0xa027
+#define SYS_TRAP_SYS_SET_TRAP_ADDRESS 0xa092
+#define SYS_TRAP_SYS_GET_TRAP_ADDRESS 0xa093
+#define SYS_TRAP_STR_COPY 0xa0c5
+#define SYS_TRAP_STR_CAT 0xa0c6
+#define SYS_TRAP_STR_LEN 0xa0c7
+
+// Charged for each native trap on top of the per byte cost. The ROM implementations move
+// memory in words and walk strings byte by byte.
+#define NATIVE_TRAP_CYCLES 50
+#define NATIVE_TRAP_CYCLES_PER_WORD 2
+#define NATIVE_TRAP_CYCLES_PER_CHAR 3
+
+enum nativeTrap {
+    native_trap_mem_move,
+    native_trap_mem_set,
+    native_trap_str_copy,
+    native_trap_str_cat,
+    native_trap_str_len,
+    native_trap_count
+};
+
+struct NativeTrapState {
+    bool patched;
+    bool romAddressKnown;
+    uint32_t romAddress;
+};
+
+static struct NativeTrapState trapStates[native_trap_count];
+
+static struct {
+    bool pending;
+    enum nativeTrap trap;
+    uint32_t pc;
+    uint32_t a7;
+} pendingGetTrapAddress;
+
+static inline uint32_t stackArg32(uint32_t offset) {
+    return uae_get32(m68k_areg(regs, 7) + offset);
+}
+
+static inline uint16_t stackArg16(uint32_t offset) {
+    return uae_get16(m68k_areg(regs, 7) + offset);
+}
+
+// A UInt8 argument is pushed with move.b, which stores it in the high byte of the stack word
+static inline uint8_t stackArg8(uint32_t offset) { return uae_get8(m68k_areg(regs, 7) + offset); }
+
+static inline bool faulted() { return paceGetFsr() != 0; }
+
+static int nativeTrapIndex(uint16_t trapNum) {
+    switch (trapNum | 0xa000) {
+        case SYS_TRAP_MEM_MOVE:
+            return native_trap_mem_move;
+
+        case SYS_TRAP_MEM_SET:
+            return native_trap_mem_set;
+
+        case SYS_TRAP_STR_COPY:
+            return native_trap_str_copy;
+
+        case SYS_TRAP_STR_CAT:
+            return native_trap_str_cat;
+
+        case SYS_TRAP_STR_LEN:
+            return native_trap_str_len;
+
+        default:
+            return -1;
+    }
+}
+
+static uint32_t strLen(uint32_t str) {
+    uint32_t len = 0;
+
+    while (uae_get8(str + len) != 0 && !faulted()) len++;
+
+    return len;
+}
+
+static uint32_t strCopy(uint32_t dest, uint32_t src) {
+    for (uint32_t i = 0;; i++) {
+        const uint8_t c = uae_get8(src + i);
+        uae_put8(dest + i, c);
+
+        if (c == 0 || faulted()) return i + 1;
+    }
+}
+
+static uint32_t memoryCycles(int32_t size) {
+    return size > 0 ? ((uint32_t)size + 3) / 4 * NATIVE_TRAP_CYCLES_PER_WORD : 0;
+}
+
+static uint32_t trap_MemMove() {
+    const uint32_t dest = stackArg32(0);
+    const uint32_t src = stackArg32(4);
+    const int32_t size = stackArg32(8);
+
+    if (size > 0 && dest != src && !faulted()) {
+        if (dest > src && dest - src < (uint32_t)size) {
+            for (int32_t i = size - 1; i >= 0 && !faulted(); i--)
+                uae_put8(dest + i, uae_get8(src + i));
+        } else {
+            for (int32_t i = 0; i < size && !faulted(); i++) uae_put8(dest + i, uae_get8(src + i));
+        }
+    }
+
+    m68k_dreg(regs, 0) = 0;
+
+    return memoryCycles(size);
+}
+
+static uint32_t trap_MemSet() {
+    const uint32_t dest = stackArg32(0);
+    const int32_t size = stackArg32(4);
+    const uint8_t value = stackArg8(8);
+
+    for (int32_t i = 0; i < size && !faulted(); i++) uae_put8(dest + i, value);
+
+    m68k_dreg(regs, 0) = 0;
+
+    return memoryCycles(size);
+}
+
+static uint32_t trap_StrCopy() {
+    const uint32_t dest = stackArg32(0);
+    const uint32_t chars = strCopy(dest, stackArg32(4));
+
+    m68k_areg(regs, 0) = dest;
+
+    return chars * NATIVE_TRAP_CYCLES_PER_CHAR;
+}
+
+static uint32_t trap_StrCat() {
+    const uint32_t dest = stackArg32(0);
+    const uint32_t src = stackArg32(4);
+
+    const uint32_t destLen = strLen(dest);
+    const uint32_t chars = destLen + strCopy(dest + destLen, src);
+
+    m68k_areg(regs, 0) = dest;
+
+    return chars * NATIVE_TRAP_CYCLES_PER_CHAR;
+}
+
+static uint32_t trap_StrLen() {
+    const uint32_t len = strLen(stackArg32(0));
+
+    m68k_dreg(regs, 0) = (uint16_t)len;
+
+    return (len + 1) * NATIVE_TRAP_CYCLES_PER_CHAR;
+}
+
+// Err SysSetTrapAddress(UInt16 trapNum, void* procP)
+static void observeSetTrapAddress() {
+    const int trap = nativeTrapIndex(stackArg16(0));
+    if (trap < 0) return;
+
+    const uint32_t proc = stackArg32(2);
+    if (faulted()) return;
+
+    struct NativeTrapState* state = &trapStates[trap];
+    state->patched = !state->romAddressKnown || proc != state->romAddress;
+}
+
+// void* SysGetTrapAddress(UInt16 trapNum), the result is picked up in
+// paceNativeTrapResumed once the ARM dispatcher returns
+static void observeGetTrapAddress() {
+    const int trap = nativeTrapIndex(stackArg16(0));
+    if (trap < 0 || faulted()) return;
+
+    const struct NativeTrapState* state = &trapStates[trap];
+    if (state->patched || state->romAddressKnown) return;
+
+    pendingGetTrapAddress.pending = true;
+    pendingGetTrapAddress.trap = trap;
+    pendingGetTrapAddress.pc = regs.pc;
+    pendingGetTrapAddress.a7 = m68k_areg(regs, 7);
+}
+
+void paceNativeTrapsReset() {
+    memset(trapStates, 0, sizeof(trapStates));
+    pendingGetTrapAddress.pending = false;
+}
+
+void paceNativeTrapResumed() {
+    if (!pendingGetTrapAddress.pending) return;
+
+    pendingGetTrapAddress.pending = false;
+
+    // Anything but a direct return from the trap leaves the ROM address unknown, which
+    // only costs us the native path for traps that are patched later on
+    if (regs.pc != pendingGetTrapAddress.pc || m68k_areg(regs, 7) != pendingGetTrapAddress.a7)
+        return;
+
+    struct NativeTrapState* state = &trapStates[pendingGetTrapAddress.trap];
+    if (state->patched) return;
+
+    state->romAddress = m68k_areg(regs, 0);
+    state->romAddressKnown = true;
+}
+
+bool paceNativeTrap(uint16_t trapWord, uint32_t* cycles) {
+    switch (trapWord) {
+        case SYS_TRAP_SYS_SET_TRAP_ADDRESS:
+            observeSetTrapAddress();
+            return false;
+
+        case SYS_TRAP_SYS_GET_TRAP_ADDRESS:
+            observeGetTrapAddress();
+            return false;
+
+        default:
+            break;
+    }
+
+    const int trap = nativeTrapIndex(trapWord);
+    if (trap < 0 || trapStates[trap].patched) return false;
+
+    switch (trap) {
+        case native_trap_mem_move:
+            *cycles = NATIVE_TRAP_CYCLES + trap_MemMove();
+            return true;
+
+        case native_trap_mem_set:
+            *cycles = NATIVE_TRAP_CYCLES + trap_MemSet();
+            return true;
+
+        case native_trap_str_copy:
+            *cycles = NATIVE_TRAP_CYCLES + trap_StrCopy();
+            return true;
+
+        case native_trap_str_cat:
+            *cycles = NATIVE_TRAP_CYCLES + trap_StrCat();
+            return true;
+
+        default:
+            *cycles = NATIVE_TRAP_CYCLES + trap_StrLen();
+            return true;
+    }
+}
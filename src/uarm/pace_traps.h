@@ -0,0 +1,25 @@
+#ifndef _PACE_TRAPS_H_
+#define _PACE_TRAPS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Execute a 68k OS trap natively inside PACE and return the cycles spent in *cycles. Returns
+// false if the trap has no native implementation or has been patched by SysSetTrapAddress and
+// needs to go through the ARM dispatcher.
+bool paceNativeTrap(uint16_t trapWord, uint32_t* cycles);
+
+// Called whenever 68k execution continues, picks up results from the ARM dispatcher
+void paceNativeTrapResumed();
+
+void paceNativeTrapsReset();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _PACE_TRAPS_H_
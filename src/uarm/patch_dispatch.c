@@ -8,7 +8,9 @@
 #include "util.h"
 
 #define MAX_PENDING_TAILPATCH 32
-#define MAX_PATCHES 50
+#define MAX_PENDING_PROFILE_FRAMES 32
+#define MAX_PATCHES 1024
+#define NO_PATCH 0xffff
 #define PATCH_TABLE_SIZE 0xc00  // 3 * 0x400
 
 struct Patch {
@@ -17,6 +19,7 @@ struct Patch {
     void* ctx;
     HeadpatchF headpatch;
     TailpatchF tailpatch;
+    ReplacementF replacement;
 };
 
 struct PendingTailpatch {
@@ -26,31 +29,94 @@ struct PendingTailpatch {
     const struct Patch* patch;
 };
 
+struct SyscallProfile {
+    uint64_t calls;
+    uint64_t instructions;
+    uint64_t nsec;
+};
+
+struct ProfileFrame {
+    uint32_t returnAddress;
+    uint32_t sp;
+    uint16_t key;
+
+    uint64_t instructions;
+    uint64_t timestamp;
+};
+
 struct PatchDispatch {
     int8_t table;
     uint8_t countdown;
 
-    uint8_t patchTable[PATCH_TABLE_SIZE];
+    uint16_t patchTable[PATCH_TABLE_SIZE];
 
     struct Patch patches[MAX_PATCHES];
     size_t nPatches;
 
     struct PendingTailpatch pendingTailpatches[MAX_PENDING_TAILPATCH];
     size_t nPendingTailpatches;
+
+    uint64_t instructions;
+
+    struct SyscallProfile* profile;
+    struct ProfileFrame profileFrames[MAX_PENDING_PROFILE_FRAMES];
+    size_t nProfileFrames;
 };
 
 struct PatchDispatch* initPatchDispatch() {
     struct PatchDispatch* pd = malloc(sizeof(*pd));
 
     memset(pd, 0, sizeof(*pd));
-    memset(pd->patchTable, 0xff, 0xc00);
+    memset(pd->patchTable, 0xff, sizeof(pd->patchTable));
 
     pd->table = -1;
 
     return pd;
 }
 
-void destroyPatchDispatch(struct PatchDispatch* pd) { free(pd); }
+void destroyPatchDispatch(struct PatchDispatch* pd) {
+    free(pd->profile);
+    free(pd);
+}
+
+static uint32_t keyToSyscall(uint32_t key) {
+    return packSyscall(((key >> 10) + 1) << 2, (key & 0x3ff) << 2);
+}
+
+static void profileEnter(struct PatchDispatch* pd, uint32_t key, const uint32_t* registers) {
+    pd->profile[key].calls++;
+
+    // syscalls that never return (ErrThrow and friends) leave stale frames behind, drop the
+    // oldest one if we run out of space
+    if (pd->nProfileFrames == MAX_PENDING_PROFILE_FRAMES) {
+        memmove(pd->profileFrames, pd->profileFrames + 1,
+                (MAX_PENDING_PROFILE_FRAMES - 1) * sizeof(*pd->profileFrames));
+        pd->nProfileFrames--;
+    }
+
+    struct ProfileFrame* frame = &pd->profileFrames[pd->nProfileFrames++];
+
+    frame->returnAddress = registers[14] & ~0x01;
+    frame->sp = registers[13];
+    frame->key = key;
+    frame->instructions = pd->instructions;
+    frame->timestamp = timestampNsec();
+}
+
+static void profileCheckReturn(struct PatchDispatch* pd, const uint32_t* registers) {
+    for (size_t i = pd->nProfileFrames; i > 0; i--) {
+        const struct ProfileFrame* frame = &pd->profileFrames[i - 1];
+        if (frame->returnAddress != registers[15] || frame->sp != registers[13]) continue;
+
+        struct SyscallProfile* profile = &pd->profile[frame->key];
+        profile->instructions += pd->instructions - frame->instructions;
+        profile->nsec += timestampNsec() - frame->timestamp;
+
+        // everything above this frame never returned
+        pd->nProfileFrames = i - 1;
+        return;
+    }
+}
 
 void patchDispatchOnLoadR12FromR9(struct PatchDispatch* pd, int32_t offset) {
     pd->table = -1;
@@ -65,8 +131,8 @@ void patchDispatchOnLoadR12FromR9(struct PatchDispatch* pd, int32_t offset) {
     pd->countdown = 2;
 }
 
-void patchDispatchOnLoadPcFromR12(struct PatchDispatch* pd, int32_t offset, uint32_t* registers) {
-    if (pd->countdown != 1 || offset < 0 || offset & 0x03 || offset > 0xfff) return;
+bool patchDispatchOnLoadPcFromR12(struct PatchDispatch* pd, int32_t offset, uint32_t* registers) {
+    if (pd->countdown != 1 || offset < 0 || offset & 0x03 || offset > 0xfff) return false;
 
 #ifdef TRACE_SYSCALLS
     const char* syscallName = getSyscallName(packSyscall(pd->table, offset));
@@ -75,17 +141,31 @@ void patchDispatchOnLoadPcFromR12(struct PatchDispatch* pd, int32_t offset, uint
 #endif
 
     const uint32_t key = (((pd->table >> 2) - 1) << 10) | (offset >> 2);
-    const uint8_t patchIdx = pd->patchTable[key];
-    if (patchIdx == 0xff) return;
+    if (pd->profile) profileEnter(pd, key, registers);
+
+    const uint16_t patchIdx = pd->patchTable[key];
+    if (patchIdx == NO_PATCH) return false;
 
     const struct Patch* patch = &pd->patches[patchIdx];
 
+    if (patch->replacement) {
+        if (!pd->profile) return patch->replacement(patch->ctx, patch->syscall, registers);
+
+        struct ProfileFrame* frame = &pd->profileFrames[pd->nProfileFrames - 1];
+        if (!patch->replacement(patch->ctx, patch->syscall, registers)) return false;
+
+        pd->profile[key].nsec += timestampNsec() - frame->timestamp;
+        pd->nProfileFrames--;
+
+        return true;
+    }
+
     if (patch->headpatch) patch->headpatch(patch->ctx, patch->syscall, registers);
     if (patch->tailpatch) {
         if (pd->nPendingTailpatches == MAX_PENDING_TAILPATCH) {
             fprintf(stderr, "too many pending tailpatches, skipping tailpatch for %#10x\n",
                     packSyscall(pd->table, offset));
-            return;
+            return false;
         }
 
         uint8_t tailpatchIdx = pd->nPendingTailpatches++;
@@ -96,10 +176,15 @@ void patchDispatchOnLoadPcFromR12(struct PatchDispatch* pd, int32_t offset, uint
         memcpy(tailpatch->registersAtInvocation, registers,
                sizeof(tailpatch->registersAtInvocation));
     }
+
+    return false;
 }
 
 void patchOnBeforeExecute(struct PatchDispatch* pd, uint32_t* registers) {
     if (pd->countdown != 0) pd->countdown--;
+    pd->instructions++;
+
+    if (pd->nProfileFrames != 0) profileCheckReturn(pd, registers);
     if (pd->nPendingTailpatches == 0) return;
 
     for (size_t i = 0; i < pd->nPendingTailpatches; i++) {
@@ -115,31 +200,119 @@ void patchOnBeforeExecute(struct PatchDispatch* pd, uint32_t* registers) {
                                                pendingTailpatch->registersAtInvocation, registers);
 
         if (i != pd->nPendingTailpatches - 1)
-            pd->pendingTailpatches[i] = pd->pendingTailpatches[pd->nPendingTailpatches];
+            pd->pendingTailpatches[i] = pd->pendingTailpatches[pd->nPendingTailpatches - 1];
 
         pd->nPendingTailpatches--;
+        i--;
     }
 }
 
-void patchDispatchAddPatch(struct PatchDispatch* pd, uint32_t syscall, HeadpatchF headpatch,
-                           TailpatchF tailpatch, void* ctx) {
+static struct Patch* allocatePatch(struct PatchDispatch* pd, uint32_t syscall) {
     const uint32_t key = (((syscall >> 14) - 1) << 10) | ((syscall & 0xfff) >> 2);
-    if (key >= PATCH_TABLE_SIZE) return;
+    if (key >= PATCH_TABLE_SIZE) return NULL;
 
     struct Patch* patch;
-    if (pd->patchTable[key] != 0xff) {
-        fprintf(stderr, "WARNING: overwriting existing patch for %#10x", syscall);
+    if (pd->patchTable[key] != NO_PATCH) {
+        fprintf(stderr, "WARNING: overwriting existing patch for %#10x\n", syscall);
         patch = &pd->patches[pd->patchTable[key]];
     } else {
-        uint8_t patchIdx = pd->nPatches++;
-        if (patchIdx >= MAX_PATCHES) ERR("WARNING: max number of patches exceeded\n");
+        if (pd->nPatches >= MAX_PATCHES) ERR("WARNING: max number of patches exceeded\n");
+        const uint16_t patchIdx = pd->nPatches++;
 
         pd->patchTable[key] = patchIdx;
         patch = &pd->patches[patchIdx];
     }
 
+    memset(patch, 0, sizeof(*patch));
     patch->syscall = syscall;
+
+    return patch;
+}
+
+void patchDispatchAddPatch(struct PatchDispatch* pd, uint32_t syscall, HeadpatchF headpatch,
+                           TailpatchF tailpatch, void* ctx) {
+    struct Patch* patch = allocatePatch(pd, syscall);
+    if (!patch) return;
+
     patch->ctx = ctx;
     patch->headpatch = headpatch;
     patch->tailpatch = tailpatch;
 }
+
+void patchDispatchAddReplacement(struct PatchDispatch* pd, uint32_t syscall,
+                                 ReplacementF replacement, void* ctx) {
+    struct Patch* patch = allocatePatch(pd, syscall);
+    if (!patch) return;
+
+    patch->ctx = ctx;
+    patch->replacement = replacement;
+}
+
+void patchDispatchSetProfiling(struct PatchDispatch* pd, bool enable) {
+    if (enable == (pd->profile != NULL)) return;
+
+    pd->nProfileFrames = 0;
+
+    if (enable) {
+        pd->profile = malloc(PATCH_TABLE_SIZE * sizeof(*pd->profile));
+        memset(pd->profile, 0, PATCH_TABLE_SIZE * sizeof(*pd->profile));
+    } else {
+        free(pd->profile);
+        pd->profile = NULL;
+    }
+}
+
+static const struct SyscallProfile* sortProfile;
+
+static int compareProfileKeys(const void* a, const void* b) {
+    const struct SyscallProfile* pa = &sortProfile[*(const uint16_t*)a];
+    const struct SyscallProfile* pb = &sortProfile[*(const uint16_t*)b];
+
+    if (pa->nsec != pb->nsec) return pa->nsec < pb->nsec ? 1 : -1;
+    if (pa->calls != pb->calls) return pa->calls < pb->calls ? 1 : -1;
+
+    return 0;
+}
+
+void patchDispatchDumpProfile(struct PatchDispatch* pd, FILE* file, bool csv) {
+    if (!pd->profile) return;
+
+    uint16_t keys[PATCH_TABLE_SIZE];
+    size_t nKeys = 0;
+    uint64_t totalNsec = 0;
+
+    for (uint16_t key = 0; key < PATCH_TABLE_SIZE; key++) {
+        if (pd->profile[key].calls == 0) continue;
+
+        keys[nKeys++] = key;
+        totalNsec += pd->profile[key].nsec;
+    }
+
+    sortProfile = pd->profile;
+    qsort(keys, nKeys, sizeof(*keys), compareProfileKeys);
+
+    if (csv)
+        fprintf(file, "syscall,name,calls,instructions,nsec\n");
+    else
+        fprintf(file, "%-10s %-32s %12s %16s %12s %12s %6s\n", "syscall", "name", "calls",
+                "instructions", "usec", "nsec/call", "%");
+
+    for (size_t i = 0; i < nKeys; i++) {
+        const struct SyscallProfile* profile = &pd->profile[keys[i]];
+        const uint32_t syscall = keyToSyscall(keys[i]);
+        const char* name = getSyscallName(syscall);
+
+        if (csv) {
+            fprintf(file, "%#06x,%s,%llu,%llu,%llu\n", syscall, name ? name : "",
+                    (unsigned long long)profile->calls, (unsigned long long)profile->instructions,
+                    (unsigned long long)profile->nsec);
+        } else {
+            fprintf(file, "%#-10x %-32s %12llu %16llu %12llu %12llu %6.2f\n", syscall,
+                    name ? name : "[unknown]", (unsigned long long)profile->calls,
+                    (unsigned long long)profile->instructions,
+                    (unsigned long long)(profile->nsec / 1000),
+                    (unsigned long long)(profile->nsec / profile->calls),
+                    totalNsec ? 100. * profile->nsec / totalNsec : 0.);
+        }
+    }
+}
@@ -1,7 +1,9 @@
 #ifndef _PATCH_DISPATCH_H_
 #define _PATCH_DISPATCH_H_
 
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #include "CPU.h"
 
@@ -12,6 +14,8 @@ extern "C" {
 typedef void (*HeadpatchF)(void* ctx, uint32_t syscall, uint32_t* registers);
 typedef void (*TailpatchF)(void* ctx, uint32_t syscall, const uint32_t* registersAtinvocation,
                            uint32_t* registers);
+// Replaces the syscall entirely. Returns false if the call should be emulated after all.
+typedef bool (*ReplacementF)(void* ctx, uint32_t syscall, uint32_t* registers);
 
 struct PatchDispatch;
 
@@ -19,11 +23,18 @@ struct PatchDispatch* initPatchDispatch();
 void destroyPatchDispatch(struct PatchDispatch* pd);
 
 void patchDispatchOnLoadR12FromR9(struct PatchDispatch* pd, int32_t offset);
-void patchDispatchOnLoadPcFromR12(struct PatchDispatch* pd, int32_t offset, uint32_t* registers);
+bool patchDispatchOnLoadPcFromR12(struct PatchDispatch* pd, int32_t offset, uint32_t* registers);
 void patchOnBeforeExecute(struct PatchDispatch* pd, uint32_t* registers);
 
 void patchDispatchAddPatch(struct PatchDispatch* pd, uint32_t syscall, HeadpatchF headpatch,
                            TailpatchF tailpatch, void* ctx);
+void patchDispatchAddReplacement(struct PatchDispatch* pd, uint32_t syscall,
+                                 ReplacementF replacement, void* ctx);
+
+// Count calls, guest instructions and host time per syscall. Times are inclusive of nested
+// syscalls.
+void patchDispatchSetProfiling(struct PatchDispatch* pd, bool enable);
+void patchDispatchDumpProfile(struct PatchDispatch* pd, FILE* file, bool csv);
 
 #ifdef __cplusplus
 }
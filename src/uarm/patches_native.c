@@ -0,0 +1,184 @@
+#include "patches_native.h"
+
+#include <string.h>
+
+#include "syscall.h"
+
+// Native replacements for hot OS routines that have no side effects beyond guest memory.
+// If guest memory faults the replacement bails out and the call is emulated, so the fault
+// is raised by the original code. This is only safe if the arguments are still intact at
+// that point, so replacements that may clobber their own input probe memory first.
+
+#define CHUNK_SIZE 1024
+#define PAGE_SIZE 1024
+#define STRING_CHUNK_SIZE 64
+
+static uint8_t buffer1[CHUNK_SIZE];
+static uint8_t buffer2[CHUNK_SIZE];
+
+static inline uint32_t stringChunkSize(uint32_t addr) {
+    const uint32_t toPageEnd = PAGE_SIZE - (addr & (PAGE_SIZE - 1));
+    return toPageEnd < STRING_CHUNK_SIZE ? toPageEnd : STRING_CHUNK_SIZE;
+}
+
+static bool replacement_MemMove(void* ctx, uint32_t syscall, uint32_t* registers) {
+    struct ArmCpu* cpu = ctx;
+    const uint32_t dest = registers[0];
+    const uint32_t src = registers[1];
+    const int32_t size = registers[2];
+
+    if (size > 0 && dest != src) {
+        // an overlapping copy destroys its source as it goes, so it must not fail halfway
+        const bool overlapping = (dest > src ? dest - src : src - dest) < (uint32_t)size;
+
+        if (overlapping &&
+            (!cpuProbeMemory(cpu, src, size, false) || !cpuProbeMemory(cpu, dest, size, true)))
+            return false;
+
+        if (dest > src && dest - src < (uint32_t)size) {
+            for (uint32_t remaining = size; remaining > 0;) {
+                const uint32_t chunk = remaining > CHUNK_SIZE ? CHUNK_SIZE : remaining;
+                remaining -= chunk;
+
+                if (!cpuReadMemory(cpu, buffer1, src + remaining, chunk) ||
+                    !cpuWriteMemory(cpu, dest + remaining, buffer1, chunk))
+                    return false;
+            }
+        } else {
+            for (uint32_t done = 0; done < (uint32_t)size;) {
+                const uint32_t chunk = size - done > CHUNK_SIZE ? CHUNK_SIZE : size - done;
+
+                if (!cpuReadMemory(cpu, buffer1, src + done, chunk) ||
+                    !cpuWriteMemory(cpu, dest + done, buffer1, chunk))
+                    return false;
+
+                done += chunk;
+            }
+        }
+    }
+
+    registers[0] = 0;
+    return true;
+}
+
+static bool replacement_MemSet(void* ctx, uint32_t syscall, uint32_t* registers) {
+    struct ArmCpu* cpu = ctx;
+    const uint32_t dest = registers[0];
+    const int32_t size = registers[1];
+
+    if (size > 0) {
+        memset(buffer1, registers[2], size > CHUNK_SIZE ? CHUNK_SIZE : size);
+
+        for (uint32_t done = 0; done < (uint32_t)size;) {
+            const uint32_t chunk = size - done > CHUNK_SIZE ? CHUNK_SIZE : size - done;
+
+            if (!cpuWriteMemory(cpu, dest + done, buffer1, chunk)) return false;
+            done += chunk;
+        }
+    }
+
+    registers[0] = 0;
+    return true;
+}
+
+static bool replacement_MemCmp(void* ctx, uint32_t syscall, uint32_t* registers) {
+    struct ArmCpu* cpu = ctx;
+    const uint32_t s1 = registers[0];
+    const uint32_t s2 = registers[1];
+    const int32_t size = registers[2];
+
+    for (uint32_t done = 0; size > 0 && done < (uint32_t)size;) {
+        const uint32_t chunk = size - done > CHUNK_SIZE ? CHUNK_SIZE : size - done;
+
+        if (!cpuReadMemory(cpu, buffer1, s1 + done, chunk) ||
+            !cpuReadMemory(cpu, buffer2, s2 + done, chunk))
+            return false;
+
+        for (uint32_t i = 0; i < chunk; i++) {
+            if (buffer1[i] != buffer2[i]) {
+                registers[0] = (int32_t)buffer1[i] - (int32_t)buffer2[i];
+                return true;
+            }
+        }
+
+        done += chunk;
+    }
+
+    registers[0] = 0;
+    return true;
+}
+
+static bool replacement_StrLen(void* ctx, uint32_t syscall, uint32_t* registers) {
+    struct ArmCpu* cpu = ctx;
+    const uint32_t str = registers[0];
+
+    for (uint32_t len = 0;;) {
+        const uint32_t chunk = stringChunkSize(str + len);
+        if (!cpuReadMemory(cpu, buffer1, str + len, chunk)) return false;
+
+        const uint8_t* terminator = memchr(buffer1, 0, chunk);
+        if (terminator) {
+            registers[0] = (uint16_t)(len + (terminator - buffer1));
+            return true;
+        }
+
+        len += chunk;
+    }
+}
+
+static bool replacement_StrCopy(void* ctx, uint32_t syscall, uint32_t* registers) {
+    struct ArmCpu* cpu = ctx;
+    const uint32_t dest = registers[0];
+    const uint32_t src = registers[1];
+
+    for (uint32_t done = 0;;) {
+        uint32_t chunk = stringChunkSize(src + done);
+        if (!cpuReadMemory(cpu, buffer1, src + done, chunk)) return false;
+
+        const uint8_t* terminator = memchr(buffer1, 0, chunk);
+        if (terminator) chunk = terminator - buffer1 + 1;
+
+        if (!cpuWriteMemory(cpu, dest + done, buffer1, chunk)) return false;
+        if (terminator) break;
+
+        done += chunk;
+    }
+
+    // r0 already holds dest
+    return true;
+}
+
+static bool replacement_StrCompareAscii(void* ctx, uint32_t syscall, uint32_t* registers) {
+    struct ArmCpu* cpu = ctx;
+    const uint32_t s1 = registers[0];
+    const uint32_t s2 = registers[1];
+
+    for (uint32_t done = 0;;) {
+        const uint32_t chunk1 = stringChunkSize(s1 + done);
+        const uint32_t chunk2 = stringChunkSize(s2 + done);
+        const uint32_t chunk = chunk1 < chunk2 ? chunk1 : chunk2;
+
+        if (!cpuReadMemory(cpu, buffer1, s1 + done, chunk) ||
+            !cpuReadMemory(cpu, buffer2, s2 + done, chunk))
+            return false;
+
+        for (uint32_t i = 0; i < chunk; i++) {
+            if (buffer1[i] != buffer2[i] || buffer1[i] == 0) {
+                registers[0] = (int32_t)buffer1[i] - (int32_t)buffer2[i];
+                return true;
+            }
+        }
+
+        done += chunk;
+    }
+}
+
+void registerNativePatches(struct PatchDispatch* patchDispatch, struct ArmCpu* cpu) {
+    patchDispatchAddReplacement(patchDispatch, SYSCALL_MEM_MOVE, replacement_MemMove, cpu);
+    patchDispatchAddReplacement(patchDispatch, SYSCALL_MEM_SET, replacement_MemSet, cpu);
+    patchDispatchAddReplacement(patchDispatch, SYSCALL_MEM_CMP, replacement_MemCmp, cpu);
+    patchDispatchAddReplacement(patchDispatch, SYSCALL_STR_LEN, replacement_StrLen, cpu);
+    patchDispatchAddReplacement(patchDispatch, SYSCALL_STR_COPY, replacement_StrCopy, cpu);
+    patchDispatchAddReplacement(patchDispatch, SYSCALL_STR_COMPARE_ASCII,
+                                replacement_StrCompareAscii, cpu);
+}
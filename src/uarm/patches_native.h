@@ -0,0 +1,17 @@
+#ifndef _PATCHES_NATIVE_H_
+#define _PATCHES_NATIVE_H_
+
+#include "CPU.h"
+#include "patch_dispatch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void registerNativePatches(struct PatchDispatch* patchDispatch, struct ArmCpu* cpu);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _PATCHES_NATIVE_H_
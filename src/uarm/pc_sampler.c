@@ -0,0 +1,229 @@
+#include "pc_sampler.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+#define INITIAL_TABLE_SIZE 4096
+#define MAX_SYMBOL_LINE 512
+
+struct SampleBucket {
+    uint32_t pc;
+    uint32_t lr;
+    uint8_t mode;
+
+    uint32_t count;
+};
+
+struct Symbol {
+    uint32_t address;
+    uint32_t size;  // 0 -> extends to the next symbol
+    char* name;
+};
+
+struct PcSampler {
+    uint32_t rateHz;
+    uint64_t cyclesToNextSample;
+
+    struct SampleBucket* buckets;
+    size_t tableSize;
+    size_t nBuckets;
+
+    struct Symbol* symbols;
+    size_t nSymbols;
+};
+
+static const char* modeNames[] = {"ARM", "Thumb", "PACE", "sleep"};
+
+static inline uint32_t hashSample(const struct PcSample* sample) {
+    uint32_t hash = sample->pc * 0x9e3779b1u;
+    hash ^= (sample->lr + sample->mode) * 0x85ebca77u;
+
+    return hash ^ (hash >> 15);
+}
+
+static struct SampleBucket* findBucket(struct SampleBucket* buckets, size_t tableSize,
+                                       const struct PcSample* sample) {
+    for (size_t i = hashSample(sample) & (tableSize - 1);; i = (i + 1) & (tableSize - 1)) {
+        struct SampleBucket* bucket = &buckets[i];
+
+        if (bucket->count == 0 || (bucket->pc == sample->pc && bucket->lr == sample->lr &&
+                                   bucket->mode == sample->mode))
+            return bucket;
+    }
+}
+
+static void growTable(struct PcSampler* sampler) {
+    const size_t tableSize = sampler->tableSize << 1;
+    struct SampleBucket* buckets = calloc(tableSize, sizeof(*buckets));
+    if (!buckets) ERR("unable to grow sample table\n");
+
+    for (size_t i = 0; i < sampler->tableSize; i++) {
+        const struct SampleBucket* bucket = &sampler->buckets[i];
+        if (bucket->count == 0) continue;
+
+        const struct PcSample sample = {.mode = bucket->mode, .pc = bucket->pc, .lr = bucket->lr};
+        *findBucket(buckets, tableSize, &sample) = *bucket;
+    }
+
+    free(sampler->buckets);
+
+    sampler->buckets = buckets;
+    sampler->tableSize = tableSize;
+}
+
+struct PcSampler* pcSamplerInit(uint32_t rateHz) {
+    struct PcSampler* sampler = malloc(sizeof(*sampler));
+    memset(sampler, 0, sizeof(*sampler));
+
+    sampler->rateHz = rateHz > 0 ? rateHz : 1;
+    sampler->tableSize = INITIAL_TABLE_SIZE;
+    sampler->buckets = calloc(sampler->tableSize, sizeof(*sampler->buckets));
+
+    return sampler;
+}
+
+void pcSamplerDestroy(struct PcSampler* sampler) {
+    for (size_t i = 0; i < sampler->nSymbols; i++) free(sampler->symbols[i].name);
+
+    free(sampler->symbols);
+    free(sampler->buckets);
+    free(sampler);
+}
+
+static int compareSymbols(const void* a, const void* b) {
+    const uint32_t addrA = ((const struct Symbol*)a)->address;
+    const uint32_t addrB = ((const struct Symbol*)b)->address;
+
+    return addrA < addrB ? -1 : (addrA > addrB ? 1 : 0);
+}
+
+bool pcSamplerLoadSymbols(struct PcSampler* sampler, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) return false;
+
+    char line[MAX_SYMBOL_LINE];
+    size_t capacity = sampler->nSymbols;
+
+    while (fgets(line, sizeof(line), file)) {
+        char* tokens[4];
+        size_t nTokens = 0;
+
+        for (char* token = strtok(line, " \t\r\n"); token && nTokens < 4;
+             token = strtok(NULL, " \t\r\n"))
+            tokens[nTokens++] = token;
+
+        if (nTokens < 2) continue;
+
+        char* end;
+        const uint32_t address = strtoul(tokens[0], &end, 16);
+        if (*end != '\0') continue;
+
+        // nm -S prints "ADDRESS SIZE TYPE NAME", without -S the size column is missing
+        uint32_t size = 0;
+        if (nTokens == 4 || (nTokens == 3 && strlen(tokens[1]) > 1))
+            size = strtoul(tokens[1], NULL, 16);
+
+        if (sampler->nSymbols == capacity) {
+            capacity = capacity ? 2 * capacity : 1024;
+            sampler->symbols = realloc(sampler->symbols, capacity * sizeof(*sampler->symbols));
+        }
+
+        struct Symbol* symbol = &sampler->symbols[sampler->nSymbols++];
+        symbol->address = address;
+        symbol->size = size;
+        symbol->name = strdup(tokens[nTokens - 1]);
+    }
+
+    fclose(file);
+
+    qsort(sampler->symbols, sampler->nSymbols, sizeof(*sampler->symbols), compareSymbols);
+
+    return true;
+}
+
+static const char* lookupSymbol(struct PcSampler* sampler, uint32_t address) {
+    size_t lo = 0, hi = sampler->nSymbols;
+
+    while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+
+        if (sampler->symbols[mid].address <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == 0) return NULL;
+
+    const struct Symbol* symbol = &sampler->symbols[lo - 1];
+    if (symbol->size > 0 && address - symbol->address >= symbol->size) return NULL;
+    if (symbol->size == 0 && lo == sampler->nSymbols) return NULL;
+
+    return symbol->name;
+}
+
+uint64_t pcSamplerCyclesToNextSample(struct PcSampler* sampler, uint64_t cyclesPerSecond) {
+    if (sampler->cyclesToNextSample == 0)
+        sampler->cyclesToNextSample = cyclesPerSecond / sampler->rateHz;
+
+    return sampler->cyclesToNextSample;
+}
+
+bool pcSamplerAdvance(struct PcSampler* sampler, uint64_t cycles, uint64_t cyclesPerSecond) {
+    if (cycles < sampler->cyclesToNextSample) {
+        sampler->cyclesToNextSample -= cycles;
+        return false;
+    }
+
+    sampler->cyclesToNextSample = cyclesPerSecond / sampler->rateHz;
+    return true;
+}
+
+void pcSamplerRecord(struct PcSampler* sampler, const struct PcSample* sample) {
+    struct SampleBucket* bucket = findBucket(sampler->buckets, sampler->tableSize, sample);
+
+    if (bucket->count++ > 0) return;
+
+    bucket->pc = sample->pc;
+    bucket->lr = sample->lr;
+    bucket->mode = sample->mode;
+
+    if (++sampler->nBuckets > sampler->tableSize / 2) growTable(sampler);
+}
+
+static void writeFrame(struct PcSampler* sampler, FILE* file, uint32_t address) {
+    const char* name = lookupSymbol(sampler, address);
+
+    if (name)
+        fprintf(file, ";%s", name);
+    else
+        fprintf(file, ";%#010x", address);
+}
+
+void pcSamplerWriteFolded(struct PcSampler* sampler, FILE* file) {
+    for (size_t i = 0; i < sampler->tableSize; i++) {
+        const struct SampleBucket* bucket = &sampler->buckets[i];
+        if (bucket->count == 0) continue;
+
+        fprintf(file, "%s", modeNames[bucket->mode]);
+
+        switch (bucket->mode) {
+            case PcSampleModeArm:
+            case PcSampleModeThumb:
+                writeFrame(sampler, file, bucket->lr & ~0x01);
+                writeFrame(sampler, file, bucket->pc);
+                break;
+
+            case PcSampleModePace:
+                fprintf(file, ";m68k:%#010x", bucket->pc);
+                break;
+
+            default:
+                break;
+        }
+
+        fprintf(file, " %u\n", bucket->count);
+    }
+}
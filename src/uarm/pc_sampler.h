@@ -0,0 +1,41 @@
+#ifndef _PC_SAMPLER_H_
+#define _PC_SAMPLER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum PcSampleMode { PcSampleModeArm, PcSampleModeThumb, PcSampleModePace, PcSampleModeSleep };
+
+struct PcSample {
+    uint8_t mode;
+    uint32_t pc;  // 68k PC in PACE mode
+    uint32_t lr;
+};
+
+struct PcSampler;
+
+struct PcSampler* pcSamplerInit(uint32_t rateHz);
+void pcSamplerDestroy(struct PcSampler* sampler);
+
+// Symbol map: one symbol per line, "ADDRESS [SIZE] [TYPE] NAME" with hex numbers. nm and
+// nm -S output works.
+bool pcSamplerLoadSymbols(struct PcSampler* sampler, const char* path);
+
+uint64_t pcSamplerCyclesToNextSample(struct PcSampler* sampler, uint64_t cyclesPerSecond);
+// Returns true if a sample is due.
+bool pcSamplerAdvance(struct PcSampler* sampler, uint64_t cycles, uint64_t cyclesPerSecond);
+void pcSamplerRecord(struct PcSampler* sampler, const struct PcSample* sample);
+
+// Folded stacks for flamegraph.pl
+void pcSamplerWriteFolded(struct PcSampler* sampler, FILE* file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _PC_SAMPLER_H_
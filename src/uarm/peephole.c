@@ -1,29 +1,44 @@
 #include "peephole.h"
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 
-static const uint32_t sig_adc_udivmod_first[] = {
+// The masked bits of a single template word are ignored, e.g. the offset of a branch out of
+// the routine
+struct PeepholeVariation {
+    size_t index;
+    uint32_t mask;
+};
+
+struct PeepholeSignature {
+    const char* name;
+    const uint32_t* code;
+    size_t length;
+    const struct PeepholeVariation* variations;
+    size_t nVariations;
+    uint32_t instr;
+};
+
+#define BRANCH_OFFSET 0x00ffffff
+
+static const uint32_t sig_adc_udivmod[] = {
     0xE3A02000, 0xE070C1A1, 0x3A000020, 0xE070C421, 0x3A00000F, 0xE1A00400, 0xE38224FF,
     0xE070C221, 0x3A000017, 0xE070C421, 0x3A000009, 0xE1A00400, 0xE38228FF, 0xE070C421,
-    0x21A00400, 0x23822CFF, 0xE070C221, 0x3A00000E, 0xE270C000};
+    0x21A00400, 0x23822CFF, 0xE070C221, 0x3A00000E, 0xE270C000, 0x2A000000, 0x21A00420,
+    0xE070C3A1, 0x20411380, 0xE0A22002, 0xE070C321, 0x20411300, 0xE0A22002, 0xE070C2A1,
+    0x20411280, 0xE0A22002, 0xE070C221, 0x20411200, 0xE0A22002, 0xE070C1A1, 0x20411180,
+    0xE0A22002, 0xE070C121, 0x20411100, 0xE0A22002, 0xE070C0A1, 0x20411080, 0xE0A22002,
+    0xE070C001, 0x20411000, 0xE0B22002, 0x2AFFFFE5, 0xE1A00002, 0xE12FFF1E};
 
-static const uint32_t sig_adc_udivmod_second[] = {
-    0x21A00420, 0xE070C3A1, 0x20411380, 0xE0A22002, 0xE070C321, 0x20411300, 0xE0A22002,
-    0xE070C2A1, 0x20411280, 0xE0A22002, 0xE070C221, 0x20411200, 0xE0A22002, 0xE070C1A1,
-    0x20411180, 0xE0A22002, 0xE070C121, 0x20411100, 0xE0A22002, 0xE070C0A1, 0x20411080,
-    0xE0A22002, 0xE070C001, 0x20411000, 0xE0B22002, 0x2AFFFFE5, 0xE1A00002, 0xE12FFF1E};
-
-static const uint32_t sig_adc_sdivmod_first[] = {
+static const uint32_t sig_adc_sdivmod[] = {
     0xE2102480, 0x42600000, 0xE0323041, 0x22611000, 0xE070C1A1, 0x3A000020, 0xE070C421, 0x3A00000F,
     0xE1A00400, 0xE38224FF, 0xE070C221, 0x3A000017, 0xE070C421, 0x3A000009, 0xE1A00400, 0xE38228FF,
-    0xE070C421, 0x21A00400, 0x23822CFF, 0xE070C221, 0x3A00000E, 0xE270C000};
-
-static const uint32_t sig_adc_sdivmod_second[] = {
-    0x21A00420, 0xE070C3A1, 0x20411380, 0xE0A22002, 0xE070C321, 0x20411300, 0xE0A22002, 0xE070C2A1,
-    0x20411280, 0xE0A22002, 0xE070C221, 0x20411200, 0xE0A22002, 0xE070C1A1, 0x20411180, 0xE0A22002,
-    0xE070C121, 0x20411100, 0xE0A22002, 0xE070C0A1, 0x20411080, 0xE0A22002, 0xE070C001, 0x20411000,
-    0xE0B22002, 0x2AFFFFE5, 0xE0320FC3, 0xE0800FA3, 0x22611000, 0xE12FFF1E};
+    0xE070C421, 0x21A00400, 0x23822CFF, 0xE070C221, 0x3A00000E, 0xE270C000, 0x2A000000, 0x21A00420,
+    0xE070C3A1, 0x20411380, 0xE0A22002, 0xE070C321, 0x20411300, 0xE0A22002, 0xE070C2A1, 0x20411280,
+    0xE0A22002, 0xE070C221, 0x20411200, 0xE0A22002, 0xE070C1A1, 0x20411180, 0xE0A22002, 0xE070C121,
+    0x20411100, 0xE0A22002, 0xE070C0A1, 0x20411080, 0xE0A22002, 0xE070C001, 0x20411000, 0xE0B22002,
+    0x2AFFFFE5, 0xE0320FC3, 0xE0800FA3, 0x22611000, 0xE12FFF1E};
 
 static const uint32_t sig_adc_udiv10[] = {0xE240100A, 0xE0400120, 0xE0800220, 0xE0800420,
                                           0xE0800820, 0xE1A001A0, 0xE0802100, 0xE0511082,
@@ -39,60 +54,147 @@ static const uint32_t sig_adc_memcpy[] = {
     0xE8BD4010, 0xE1B0CF02, 0x24913004, 0x24803004, 0x012FFF1E, 0xE1B02F82, 0x44D12001,
     0x24D13001, 0x24D1C001, 0x44C02001, 0x24C03001, 0x24C0C001, 0xE12FFF1E};
 
-const size_t OFFSET_PEEPHOLE_ADS_UDIVMOD_DIVISION_BY_ZERO = sizeof(sig_adc_udivmod_first);
-const size_t OFFSET_PEEPHOLE_ADS_SDIVMOD_DIVISION_BY_ZERO = sizeof(sig_adc_sdivmod_first);
+#define LENGTH(sig) (sizeof(sig) / sizeof(sig[0]))
+
+// The branch that closes the first half of the division loop differs between builds. A
+// division by zero continues there.
+#define ADS_UDIVMOD_DIVISION_BY_ZERO 19
+#define ADS_SDIVMOD_DIVISION_BY_ZERO 22
+
+static const struct PeepholeVariation variations_adc_udivmod[] = {
+    {.index = ADS_UDIVMOD_DIVISION_BY_ZERO, .mask = BRANCH_OFFSET}};
+
+static const struct PeepholeVariation variations_adc_sdivmod[] = {
+    {.index = ADS_SDIVMOD_DIVISION_BY_ZERO, .mask = BRANCH_OFFSET}};
+
+#define SIGNATURE(sig) .code = sig, .length = LENGTH(sig)
+#define VARIATIONS(table) .variations = table, .nVariations = LENGTH(table)
+
+static const struct PeepholeSignature signatures[] = {
+    {.name = "ADS udivmod",
+     SIGNATURE(sig_adc_udivmod),
+     VARIATIONS(variations_adc_udivmod),
+     .instr = INSTR_PEEPHOLE_ADS_UDIVMOD},
+    {.name = "ADS sdivmod",
+     SIGNATURE(sig_adc_sdivmod),
+     VARIATIONS(variations_adc_sdivmod),
+     .instr = INSTR_PEEPHOLE_ADS_SDIVMOD},
+    {.name = "ADS udiv10", SIGNATURE(sig_adc_udiv10), .instr = INSTR_PEEPHOLE_ADS_UDIV10},
+    {.name = "ADS sdiv10", SIGNATURE(sig_adc_sdiv10), .instr = INSTR_PEEPHOLE_ADS_SDIV10},
+    {.name = "ADS memcpy", SIGNATURE(sig_adc_memcpy), .instr = INSTR_PEEPHOLE_ADS_MEMCPY}};
+
+#define SIGNATURE_COUNT LENGTH(signatures)
+
+const size_t OFFSET_PEEPHOLE_ADS_UDIVMOD_DIVISION_BY_ZERO = ADS_UDIVMOD_DIVISION_BY_ZERO * 4;
+const size_t OFFSET_PEEPHOLE_ADS_SDIVMOD_DIVISION_BY_ZERO = ADS_SDIVMOD_DIVISION_BY_ZERO * 4;
+
+// Signatures are bucketed by the opcode bits of their first word, so each position costs a
+// single lookup instead of a pass over the whole table. Signatures that allow those bits
+// to vary are checked everywhere.
+#define BUCKET_SHIFT 20
+#define BUCKET_MASK (0xffu << BUCKET_SHIFT)
+#define BUCKET_COUNT 256
+
+static struct {
+    bool built;
+    uint8_t start[BUCKET_COUNT + 1];
+    uint8_t signatures[SIGNATURE_COUNT];
+    uint8_t nUnbucketed;
+    uint8_t unbucketed[SIGNATURE_COUNT];
+} signatureIndex;
+
+static uint32_t firstWordMask(const struct PeepholeSignature* signature) {
+    return signature->nVariations > 0 && signature->variations[0].index == 0
+               ? signature->variations[0].mask
+               : 0;
+}
+
+static bool bucketed(const struct PeepholeSignature* signature) {
+    return (firstWordMask(signature) & BUCKET_MASK) == 0;
+}
 
-static void optimizeAt_ADC_udivmod(uint32_t* code, size_t size) {
-    if (size < sizeof(sig_adc_udivmod_first) + sizeof(sig_adc_udivmod_second) + 4) return;
+static size_t bucketOf(uint32_t word) { return (word & BUCKET_MASK) >> BUCKET_SHIFT; }
 
-    if (memcmp(code, sig_adc_udivmod_first, sizeof(sig_adc_udivmod_first)) != 0) return;
-    if ((code[sizeof(sig_adc_udivmod_first) / 4] >> 24) != 0x2a) return;
-    if (memcmp(code + sizeof(sig_adc_udivmod_first) / 4 + 1, sig_adc_udivmod_second,
-               sizeof(sig_adc_udivmod_second)) != 0)
-        return;
+static void buildSignatureIndex() {
+    size_t counts[BUCKET_COUNT] = {0};
 
-    *code = INSTR_PEEPHOLE_ADS_UDIVMOD;
-}
+    for (size_t i = 0; i < SIGNATURE_COUNT; i++) {
+        if (bucketed(signatures + i))
+            counts[bucketOf(signatures[i].code[0])]++;
+        else
+            signatureIndex.unbucketed[signatureIndex.nUnbucketed++] = i;
+    }
+
+    for (size_t i = 0; i < BUCKET_COUNT; i++)
+        signatureIndex.start[i + 1] = signatureIndex.start[i] + counts[i];
 
-static void optimizeAt_ADC_sdivmod(uint32_t* code, size_t size) {
-    if (size < sizeof(sig_adc_sdivmod_first) + sizeof(sig_adc_sdivmod_second) + 4) return;
+    uint8_t fill[BUCKET_COUNT];
+    memcpy(fill, signatureIndex.start, sizeof(fill));
 
-    if (memcmp(code, sig_adc_sdivmod_first, sizeof(sig_adc_sdivmod_first)) != 0) return;
-    if ((code[sizeof(sig_adc_sdivmod_first) / 4] >> 24) != 0x2a) return;
-    if (memcmp(code + sizeof(sig_adc_sdivmod_first) / 4 + 1, sig_adc_sdivmod_second,
-               sizeof(sig_adc_sdivmod_second)) != 0)
-        return;
+    for (size_t i = 0; i < SIGNATURE_COUNT; i++)
+        if (bucketed(signatures + i))
+            signatureIndex.signatures[fill[bucketOf(signatures[i].code[0])]++] = i;
 
-    *code = INSTR_PEEPHOLE_ADS_SDIVMOD;
+    signatureIndex.built = true;
 }
 
-static void optimizeAt_ADC_udiv10(uint32_t* code, size_t size) {
-    if (size < sizeof(sig_adc_udiv10)) return;
-    if (memcmp(code, sig_adc_udiv10, sizeof(sig_adc_udiv10)) != 0) return;
+static bool matchSignature(const uint32_t* code, size_t index, size_t words,
+                           const struct PeepholeSignature* signature) {
+    if (words - index < signature->length) return false;
 
-    *code = INSTR_PEEPHOLE_ADS_UDIV10;
-}
+    const struct PeepholeVariation* variation = signature->variations;
+    const struct PeepholeVariation* variationsEnd = variation + signature->nVariations;
+
+    for (size_t i = 0; i < signature->length; i++) {
+        const uint32_t word = code[index + i];
+
+        if (variation == variationsEnd || variation->index != i) {
+            if (word != signature->code[i]) return false;
+            continue;
+        }
+
+        if ((word ^ signature->code[i]) & ~variation->mask) return false;
 
-static void optimizeAt_ADC_sdiv10(uint32_t* code, size_t size) {
-    if (size < sizeof(sig_adc_sdiv10)) return;
-    if (memcmp(code, sig_adc_sdiv10, sizeof(sig_adc_sdiv10)) != 0) return;
+        variation++;
+    }
+
+    return true;
+}
 
-    *code = INSTR_PEEPHOLE_ADS_SDIV10;
+static bool matchFirstWord(uint32_t word, const struct PeepholeSignature* signature) {
+    return ((word ^ signature->code[0]) & ~firstWordMask(signature)) == 0;
 }
 
-static void optimizeAt_ADC_memcpy(uint32_t* code, size_t size) {
-    if (size < sizeof(sig_adc_memcpy)) return;
-    if (memcmp(code, sig_adc_memcpy, sizeof(sig_adc_memcpy)) != 0) return;
+uint32_t peepholeMatch(const uint32_t* code, size_t index, size_t words) {
+    if (index >= words) return 0;
+    if (!signatureIndex.built) buildSignatureIndex();
+
+    const uint32_t first = code[index];
+    const size_t bucket = bucketOf(first);
+
+    for (size_t i = signatureIndex.start[bucket]; i < signatureIndex.start[bucket + 1]; i++) {
+        const struct PeepholeSignature* signature = signatures + signatureIndex.signatures[i];
+
+        if (matchFirstWord(first, signature) && matchSignature(code, index, words, signature))
+            return signature->instr;
+    }
+
+    for (size_t i = 0; i < signatureIndex.nUnbucketed; i++) {
+        const struct PeepholeSignature* signature = signatures + signatureIndex.unbucketed[i];
+
+        if (matchFirstWord(first, signature) && matchSignature(code, index, words, signature))
+            return signature->instr;
+    }
 
-    *code = INSTR_PEEPHOLE_ADS_MEMCPY;
+    return 0;
 }
 
 void peepholeOptimize(uint32_t* code, size_t size) {
-    for (size = size & ~0x03; size > 0; size -= 4, code++) {
-        optimizeAt_ADC_udivmod(code, size);
-        optimizeAt_ADC_sdivmod(code, size);
-        optimizeAt_ADC_udiv10(code, size);
-        optimizeAt_ADC_sdiv10(code, size);
-        optimizeAt_ADC_memcpy(code, size);
+    const size_t words = size >> 2;
+
+    for (size_t i = 0; i < words; i++) {
+        const uint32_t instr = peepholeMatch(code, i, words);
+
+        if (instr) code[i] = instr;
     }
 }
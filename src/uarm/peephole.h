@@ -17,10 +17,14 @@ extern "C" {
 extern const size_t OFFSET_PEEPHOLE_ADS_UDIVMOD_DIVISION_BY_ZERO;
 extern const size_t OFFSET_PEEPHOLE_ADS_SDIVMOD_DIVISION_BY_ZERO;
 
+// Returns the replacement instruction if one of the known signatures starts at code[index].
+// Calls made by the idiom are only followed within the words of code.
+uint32_t peepholeMatch(const uint32_t* code, size_t index, size_t words);
+
 void peepholeOptimize(uint32_t* code, size_t size);
 
 #ifdef __cplusplus
 }
 #endif
 
-#endif  // _PEEPHOLE_H_
\ No newline at end of file
+#endif  // _PEEPHOLE_H_
@@ -0,0 +1,123 @@
+#ifdef VALIDATE_PEEPHOLE
+
+#include "peephole_validate.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "peephole.h"
+
+struct ValidatedIdiom {
+    uint32_t instr;
+    const char* name;
+    uint8_t nArgs;
+    bool nonzeroFirstArg;  // r0 is a divisor
+};
+
+// memcpy is left out as it has side effects beyond r0 / r1
+static const struct ValidatedIdiom validatedIdioms[] = {
+    {.instr = INSTR_PEEPHOLE_ADS_UDIVMOD, .name = "udivmod", .nArgs = 2, .nonzeroFirstArg = true},
+    {.instr = INSTR_PEEPHOLE_ADS_SDIVMOD, .name = "sdivmod", .nArgs = 2, .nonzeroFirstArg = true},
+    {.instr = INSTR_PEEPHOLE_ADS_UDIV10, .name = "udiv10", .nArgs = 1},
+    {.instr = INSTR_PEEPHOLE_ADS_SDIV10, .name = "sdiv10", .nArgs = 1}};
+
+#define VALIDATED_IDIOM_COUNT (sizeof(validatedIdioms) / sizeof(validatedIdioms[0]))
+
+static const uint32_t edgeCases[] = {0,          1,          2,          3,         9,
+                                     10,         11,         0x7fffffff, 0x80000000, 0x80000001,
+                                     0xfffffff6, 0xffffffff, 0xfffffffe, 0x0000ffff, 0x00010000};
+
+#define EDGE_CASE_COUNT (sizeof(edgeCases) / sizeof(edgeCases[0]))
+
+static uint32_t randomOperand(size_t iteration) {
+    if (iteration < EDGE_CASE_COUNT * EDGE_CASE_COUNT) return edgeCases[rand() % EDGE_CASE_COUNT];
+
+    const uint32_t value = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+
+    // mix in small magnitudes, the division loops take different paths for those
+    switch (rand() & 3) {
+        case 0:
+            return value & 0xff;
+
+        case 1:
+            return value & 0xffff;
+
+        default:
+            return value;
+    }
+}
+
+static void runIdiom(struct ArmCpu* cpu, uint32_t entry, const uint32_t* args, uint8_t nArgs,
+                     uint32_t* result) {
+    struct ArmCpu* scratchState = cpuPrepareInjectedCall(cpu, NULL);
+    uint32_t* registers = cpuGetRegisters(scratchState);
+
+    for (uint8_t i = 0; i < nArgs; i++) registers[i] = args[i];
+
+    cpuExecuteInjectedCallAt(scratchState, entry);
+
+    result[0] = registers[0];
+    result[1] = registers[1];
+
+    cpuFinishInjectedCall(cpu, scratchState);
+    free(scratchState);
+}
+
+static bool validateAt(struct ArmCpu* cpu, uint32_t entry, uint32_t* patchLocation,
+                       uint32_t original, const struct ValidatedIdiom* idiom, size_t iterations) {
+    const uint32_t patched = *patchLocation;
+    size_t mismatches = 0;
+
+    for (size_t i = 0; i < iterations; i++) {
+        uint32_t args[2], native[2], emulated[2];
+
+        for (uint8_t iArg = 0; iArg < idiom->nArgs; iArg++) args[iArg] = randomOperand(i);
+        if (idiom->nonzeroFirstArg && args[0] == 0) args[0] = 1;
+
+        *patchLocation = patched;
+        cpuIcacheInval(cpu);
+        runIdiom(cpu, entry, args, idiom->nArgs, native);
+
+        *patchLocation = original;
+        cpuIcacheInval(cpu);
+        runIdiom(cpu, entry, args, idiom->nArgs, emulated);
+
+        if (native[0] == emulated[0] && native[1] == emulated[1]) continue;
+
+        if (mismatches++ < 10)
+            fprintf(stderr,
+                    "peephole %s at 0x%08x: args 0x%08x 0x%08x -> native 0x%08x 0x%08x, emulated "
+                    "0x%08x 0x%08x\n",
+                    idiom->name, entry, args[0], idiom->nArgs > 1 ? args[1] : 0, native[0],
+                    native[1], emulated[0], emulated[1]);
+    }
+
+    *patchLocation = patched;
+    cpuIcacheInval(cpu);
+
+    fprintf(stderr, "peephole %s at 0x%08x: %zu / %zu mismatches\n", idiom->name, entry,
+            mismatches, iterations);
+
+    return mismatches == 0;
+}
+
+bool peepholeValidate(struct ArmCpu* cpu, uint32_t romBase, const uint32_t* romOriginal,
+                      uint32_t* romPeephole, size_t size, size_t iterations) {
+    bool ok = true;
+
+    srand(0x5eed);
+
+    for (size_t i = 0; i < size / 4; i++) {
+        for (size_t iIdiom = 0; iIdiom < VALIDATED_IDIOM_COUNT; iIdiom++) {
+            if (romPeephole[i] != validatedIdioms[iIdiom].instr) continue;
+
+            ok = validateAt(cpu, romBase + i * 4, romPeephole + i, romOriginal[i],
+                            validatedIdioms + iIdiom, iterations) &&
+                 ok;
+        }
+    }
+
+    return ok;
+}
+
+#endif  // VALIDATE_PEEPHOLE
@@ -0,0 +1,24 @@
+#ifndef _PEEPHOLE_VALIDATE_H_
+#define _PEEPHOLE_VALIDATE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CPU.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Run every register-only idiom found in the ROM against the emulated original with
+// random operands. Must be called on a freshly reset CPU (MMU off). Returns true if all
+// results agree.
+bool peepholeValidate(struct ArmCpu* cpu, uint32_t romBase, const uint32_t* romOriginal,
+                      uint32_t* romPeephole, size_t size, size_t iterations);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _PEEPHOLE_VALIDATE_H_
@@ -414,3 +414,38 @@ void socAC97clientClientHaveData(struct SocAC97 *ac97, enum Ac97Codec which, uin
 
     (void)socAC97PrvFifoAdd(ac97, &cd->rxFifo, data);
 }
+
+uint32_t socAC97clientClientWantDataN(struct SocAC97 *ac97, enum Ac97Codec which, uint32_t *data,
+                                      uint32_t count) {
+    struct AC97Fifo *fifo = &socAC97prvCodecPtrGet(ac97, which)->txFifo;
+    const uint32_t cap = sizeof(fifo->data) / sizeof(*fifo->data);
+    const uint32_t available = count < fifo->numItems ? count : fifo->numItems;
+
+    for (uint32_t i = 0; i < available; i++) {
+        data[i] = fifo->data[fifo->readPtr];
+        if (++fifo->readPtr == cap) fifo->readPtr = 0;
+    }
+
+    fifo->numItems -= available;
+
+    if (available < count) *fifo->isr |= 0x10;  // empty
+
+    socAC97PrvFifoDmaUpdate(ac97, fifo);
+
+    return available;
+}
+
+void socAC97clientClientHaveDataN(struct SocAC97 *ac97, enum Ac97Codec which, const uint32_t *data,
+                                  uint32_t count) {
+    struct AC97Fifo *fifo = &socAC97prvCodecPtrGet(ac97, which)->rxFifo;
+    const uint32_t cap = sizeof(fifo->data) / sizeof(*fifo->data);
+    const uint32_t space = cap - fifo->numItems;
+    const uint32_t accepted = count < space ? count : space;
+
+    for (uint32_t i = 0; i < accepted; i++)
+        fifo->data[(fifo->readPtr + fifo->numItems++) % cap] = data[i];
+
+    if (accepted < count) *fifo->isr |= 0x10;  // full
+
+    socAC97PrvFifoDmaUpdate(ac97, fifo);
+}
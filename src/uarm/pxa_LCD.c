@@ -7,6 +7,7 @@
 #include <string.h>
 
 #include "SoC.h"
+#include "lcd_convert.h"
 #include "mem.h"
 #include "pxa_IC.h"
 #include "util.h"
@@ -15,11 +16,18 @@
 #define PXA_LCD_SIZE 0x00001000UL
 
 #define LCD_STATE_IDLE 0
-#define LCD_STATE_DMA_0_START 1
-#define LCD_STATE_DMA_0_END 2
+#define LCD_STATE_FRAME 1
+
+// EOF follows after the active part of the frame, the remaining ticks are vertical blanking
+#define LCD_TICKS_ACTIVE (PXA_LCD_TICKS_PER_FRAME - 1)
+
+// palette descriptors are chained in front of the frame descriptor and load in the same refresh
+#define LCD_MAX_DESCRIPTORS_PER_FRAME 4
 
 #define UNMASKABLE_INTS 0x7C8E
 
+#define PALETTE_EXPANDED_INVALID 0xff
+
 struct PxaLcd {
     struct SocIc *ic;
     struct ArmMem *mem;
@@ -39,6 +47,8 @@ struct PxaLcd {
 
     uint8_t palette[512] __attribute__((aligned(2)));
     uint32_t palette_mapped[512];
+    uint32_t palette_expanded[LCD_EXPANDED_PALETTE_SIZE];
+    uint8_t paletteExpandedBpp;
 
     uint16_t width;
     uint16_t height;
@@ -46,10 +56,30 @@ struct PxaLcd {
     uint32_t *front_buffer;
     uint32_t *back_buffer;
 
+    bool nativeOutput;
+    uint8_t frontFormat;
+    uint8_t backFormat;
+    uint32_t *front_palette;
+    uint32_t *back_palette;
+
     uint32_t i_pixel;
     bool frame_pending;
 
-    uint32_t frameNum;
+    // Row bitmaps: written since the last conversion, differing between front and back
+    // buffer, and changed in the pending frame
+    uint32_t *dirtyRows;
+    uint32_t *staleRows;
+    uint32_t *damageRows;
+    uint32_t rowWords;
+    uint32_t rowBytes;
+    bool rowsDirty;
+
+    struct FrameDamageSpan *damageSpans;
+    uint32_t nDamageSpans;
+
+    uint32_t refreshHz;
+    uint32_t captureHz;
+    uint32_t captureAccumulator;
 
     uint32_t framebufferBase;
     uint32_t framebufferSize;
@@ -58,18 +88,6 @@ struct PxaLcd {
     bool framebufferTrackingActive;
 };
 
-static uint32_t unpack_rgb16(uint16_t rgb16) {
-    uint8_t r = (rgb16 >> 11) & 0x1f;
-    uint8_t g = (rgb16 >> 5) & 0x3f;
-    uint8_t b = (rgb16 >> 0) & 0x1f;
-
-    r = (r << 3) | (r >> 2);
-    g = (g << 2) | (g >> 4);
-    b = (b << 3) | (b >> 2);
-
-    return 0xff000000 | (b << 16) | (g << 8) | r;
-}
-
 static void pxaLcdPrvUpdateInts(struct PxaLcd *lcd) {
     uint_fast16_t ints = lcd->lcsr & lcd->intMask;
 
@@ -315,28 +333,192 @@ static void pxaLcdUpdatePalette(struct PxaLcd *lcd, int32_t len) {
     bool dirty = false;
 
     for (uint32_t i = 0; i < n_entries; i++, entry++, entry_mapped++) {
-        uint32_t unpacked = unpack_rgb16(*entry);
+        uint32_t unpacked = lcdUnpackRgb565(*entry);
         dirty = dirty || (unpacked != *entry_mapped);
 
-        if (dirty) *entry_mapped = unpack_rgb16(*entry);
+        if (dirty) *entry_mapped = lcdUnpackRgb565(*entry);
+    }
+
+    if (dirty) {
+        lcd->paletteExpandedBpp = PALETTE_EXPANDED_INVALID;
+        socSetFramebufferDirty(lcd->soc);
     }
+}
+
+static void pxaLcdPrvSetAllRows(struct PxaLcd *lcd, uint32_t *rows) {
+    memset(rows, 0, lcd->rowWords * sizeof(uint32_t));
+
+    for (uint32_t row = 0; row < lcd->height; row++) rows[row >> 5] |= 1u << (row & 31);
+}
+
+// Find the next run of set rows at or after *row, returns the number of rows in the run
+static uint32_t pxaLcdPrvNextRun(struct PxaLcd *lcd, const uint32_t *rows, uint32_t *row) {
+    uint32_t first = *row;
+
+    while (first < lcd->height && !(rows[first >> 5] & (1u << (first & 31)))) {
+        if ((first & 31) == 0 && rows[first >> 5] == 0)
+            first += 32;
+        else
+            first++;
+    }
+
+    if (first >= lcd->height) return 0;
+
+    uint32_t last = first;
+    while (last < lcd->height && (rows[last >> 5] & (1u << (last & 31)))) last++;
+
+    *row = last;
+
+    return last - first;
+}
+
+static void pxaLcdPrvSwapBuffers(struct PxaLcd *lcd, const uint32_t *damage) {
+    lcd->i_pixel = 0;
+
+    // accumulate if the consumer has not picked up the previous frame yet
+    for (uint32_t i = 0; i < lcd->rowWords; i++)
+        lcd->damageRows[i] = lcd->frame_pending ? lcd->damageRows[i] | damage[i] : damage[i];
+
+    lcd->nDamageSpans = 0;
+    uint32_t row = 0, nRows;
+    while ((nRows = pxaLcdPrvNextRun(lcd, lcd->damageRows, &row)) > 0) {
+        lcd->damageSpans[lcd->nDamageSpans].firstRow = row - nRows;
+        lcd->damageSpans[lcd->nDamageSpans].nRows = nRows;
+        lcd->nDamageSpans++;
+    }
+
+    lcd->frame_pending = true;
+
+    uint32_t *front_buffer = lcd->front_buffer;
+    lcd->front_buffer = lcd->back_buffer;
+    lcd->back_buffer = front_buffer;
+
+    uint32_t *front_palette = lcd->front_palette;
+    lcd->front_palette = lcd->back_palette;
+    lcd->back_palette = front_palette;
 
-    if (dirty) socSetFramebufferDirty(lcd->soc);
+    const uint8_t frontFormat = lcd->frontFormat;
+    lcd->frontFormat = lcd->backFormat;
+    lcd->backFormat = frontFormat;
 }
 
 static void pxaLcdPrvScreenDataPixel(struct PxaLcd *lcd, uint32_t color) {
     lcd->back_buffer[lcd->i_pixel++] = color;
 
     if (lcd->i_pixel == lcd->width * lcd->height) {
-        lcd->i_pixel = 0;
-        lcd->frame_pending = true;
+        pxaLcdPrvSetAllRows(lcd, lcd->staleRows);
+        pxaLcdPrvSwapBuffers(lcd, lcd->staleRows);
+    }
+}
+
+static uint8_t pxaLcdPrvOutputFormat(struct PxaLcd *lcd, uint8_t bpp) {
+    if (!lcd->nativeOutput) return frameFormatAbgr8888;
+
+    return bpp == 4 ? frameFormatRgb565 : frameFormatIndexed8;
+}
+
+static uint32_t pxaLcdPrvBytesPerPixel(uint8_t format) {
+    switch (format) {
+        case frameFormatRgb565:
+            return 2;
 
-        uint32_t *front_buffer = lcd->front_buffer;
-        lcd->front_buffer = lcd->back_buffer;
-        lcd->back_buffer = front_buffer;
+        case frameFormatIndexed8:
+            return 1;
+
+        default:
+            return 4;
     }
 }
 
+static void pxaLcdPrvConvertRange(struct PxaLcd *lcd, uint8_t *dest, uint32_t addr,
+                                  uint32_t len, uint8_t bpp) {
+    uint8_t bounce[MEM_HOST_PAGE_SIZE] __attribute__((aligned(4)));
+
+    while (len > 0) {
+        uint32_t chunk = MEM_HOST_PAGE_SIZE - (addr & (MEM_HOST_PAGE_SIZE - 1));
+        if (chunk > len) chunk = len;
+
+        struct MemHostPage page;
+        const uint8_t *src;
+
+        if (memGetHostPage(lcd->mem, addr, false, &page)) {
+            src = page.host + (addr & (MEM_HOST_PAGE_SIZE - 1));
+        } else {
+            pxaLcdPrvDma(lcd, bounce, addr, chunk);
+            src = bounce;
+        }
+
+        switch (lcd->backFormat) {
+            case frameFormatRgb565:
+                memcpy(dest, src, chunk);
+                dest += chunk;
+                break;
+
+            case frameFormatIndexed8:
+                dest = lcdConvertToIndexed8(dest, src, chunk, bpp);
+                break;
+
+            default:
+                dest = (uint8_t *)lcdConvert((uint32_t *)dest, src, chunk, bpp,
+                                             lcd->palette_mapped, lcd->palette_expanded);
+                break;
+        }
+
+        addr += chunk;
+        len -= chunk;
+    }
+}
+
+// Convert a framebuffer that holds exactly one frame, reading directly from host memory
+// where possible. Unless the whole frame is dirty only rows that were written since the last
+// frame or that differ between the two buffers are converted.
+static bool pxaLcdPrvScreenDataConvert(struct PxaLcd *lcd, uint32_t addr, uint32_t len,
+                                       uint8_t bpp) {
+    if (lcd->i_pixel != 0 || bpp > 4 || (addr & 3) ||
+        len != ((uint32_t)(lcd->width * lcd->height) << bpp) >> 3)
+        return false;
+
+    const uint8_t format = pxaLcdPrvOutputFormat(lcd, bpp);
+
+    if (format == frameFormatAbgr8888 && bpp < 3 && lcd->paletteExpandedBpp != bpp) {
+        lcdExpandPalette(lcd->palette_expanded, lcd->palette_mapped, bpp);
+        lcd->paletteExpandedBpp = bpp;
+    }
+
+    if (format == frameFormatIndexed8)
+        memcpy(lcd->back_palette, lcd->palette_mapped, 256 * sizeof(uint32_t));
+
+    const uint32_t bytesPerPixel = pxaLcdPrvBytesPerPixel(format);
+    uint8_t *dest = (uint8_t *)lcd->back_buffer;
+
+    // the back buffer can only be patched if it holds the previous frame in the same format
+    if (lcd->framebufferDirty || !lcd->framebufferTrackingActive || lcd->backFormat != format) {
+        lcd->backFormat = format;
+
+        pxaLcdPrvConvertRange(lcd, dest, addr, len, bpp);
+        pxaLcdPrvSetAllRows(lcd, lcd->dirtyRows);
+    } else {
+        for (uint32_t i = 0; i < lcd->rowWords; i++) lcd->staleRows[i] |= lcd->dirtyRows[i];
+
+        uint32_t row = 0, nRows;
+        while ((nRows = pxaLcdPrvNextRun(lcd, lcd->staleRows, &row)) > 0) {
+            const uint32_t first = row - nRows;
+
+            pxaLcdPrvConvertRange(lcd, dest + first * lcd->width * bytesPerPixel,
+                                  addr + first * lcd->rowBytes, nRows * lcd->rowBytes, bpp);
+        }
+    }
+
+    // After the swap the new back buffer lags behind in exactly the rows that changed now
+    memcpy(lcd->staleRows, lcd->dirtyRows, lcd->rowWords * sizeof(uint32_t));
+    memset(lcd->dirtyRows, 0, lcd->rowWords * sizeof(uint32_t));
+    lcd->rowsDirty = false;
+
+    pxaLcdPrvSwapBuffers(lcd, lcd->staleRows);
+
+    return true;
+}
+
 static void pxaLcdPrvScreenDataDma(struct PxaLcd *lcd, uint32_t addr /*PA*/, uint32_t len) {
     uint8_t data[4];
     uint32_t i, j;
@@ -351,6 +533,7 @@ static void pxaLcdPrvScreenDataDma(struct PxaLcd *lcd, uint32_t addr /*PA*/, uin
             fprintf(stderr, "framebuffer now at 0x%08x , size %u bytes, %d bpp\n", addr, len,
                     (int)(1 << bpp));
 
+            lcd->rowBytes = len / lcd->height;
             lcd->framebufferDirty = true;
             lcd->framebufferTrackingActive = socSetFramebuffer(lcd->soc, addr, len);
         } else {
@@ -365,7 +548,14 @@ static void pxaLcdPrvScreenDataDma(struct PxaLcd *lcd, uint32_t addr /*PA*/, uin
         }
     }
 
-    if (lcd->framebufferTrackingActive && !lcd->framebufferDirty) return;
+    if (lcd->framebufferTrackingActive && !lcd->framebufferDirty && !lcd->rowsDirty) return;
+
+    if (pxaLcdPrvScreenDataConvert(lcd, addr, len, bpp)) {
+        lcd->framebufferDirty = false;
+        return;
+    }
+
+    lcd->backFormat = frameFormatAbgr8888;
 
     len /= 4;
     while (len--) {
@@ -405,8 +595,8 @@ static void pxaLcdPrvScreenDataDma(struct PxaLcd *lcd, uint32_t addr /*PA*/, uin
 
             case 4:  // 16BPP
 
-                pxaLcdPrvScreenDataPixel(lcd, unpack_rgb16(*(uint16_t *)(&data[0])));
-                pxaLcdPrvScreenDataPixel(lcd, unpack_rgb16(*(uint16_t *)(&data[2])));
+                pxaLcdPrvScreenDataPixel(lcd, lcdUnpackRgb565(*(uint16_t *)(&data[0])));
+                pxaLcdPrvScreenDataPixel(lcd, lcdUnpackRgb565(*(uint16_t *)(&data[2])));
                 break;
 
             default:
@@ -415,12 +605,62 @@ static void pxaLcdPrvScreenDataDma(struct PxaLcd *lcd, uint32_t addr /*PA*/, uin
         }
     }
 
+    memset(lcd->dirtyRows, 0, lcd->rowWords * sizeof(uint32_t));
+    lcd->rowsDirty = false;
     lcd->framebufferDirty = false;
 }
 
-void pxaLcdTick(struct PxaLcd *lcd) {
-    // every other call starts a frame, the others end one [this generates spacing between
-    // interrupts so as to not confuse guest OS]
+static void pxaLcdPrvFetchDescriptor(struct PxaLcd *lcd) {
+    uint32_t descrAddr;
+
+    if (lcd->fbr[0] & 1) {  // branch
+
+        lcd->fbr[0] &= ~1UL;
+        if (lcd->fbr[0] & 2) lcd->lcsr |= 0x0200;
+        descrAddr = lcd->fbr[0] & ~0xFUL;
+    } else
+        descrAddr = lcd->fdadr[0];
+    lcd->fdadr[0] = pxaLcdPrvGetWord(lcd, descrAddr + 0);
+    lcd->fsadr[0] = pxaLcdPrvGetWord(lcd, descrAddr + 4);
+    lcd->fidr[0] = pxaLcdPrvGetWord(lcd, descrAddr + 8);
+    lcd->ldcmd[0] = pxaLcdPrvGetWord(lcd, descrAddr + 12);
+}
+
+// Walk the descriptor chain up to the next frame descriptor, returns false if there is none
+static bool pxaLcdPrvStartFrame(struct PxaLcd *lcd) {
+    for (uint32_t i = 0; i < LCD_MAX_DESCRIPTORS_PER_FRAME; i++) {
+        pxaLcdPrvFetchDescriptor(lcd);
+
+        if (lcd->ldcmd[0] & 0x00400000UL) lcd->lcsr |= 0x0002;  // set SOF is DMA 0 started
+        uint32_t len = lcd->ldcmd[0] & 0x000FFFFFUL;
+
+        if (!(lcd->ldcmd[0] & 0x04000000UL)) {
+            // capture runs at its own rate, independent of the refresh seen by the guest
+            lcd->captureAccumulator += lcd->captureHz;
+            if (lcd->captureAccumulator >= lcd->refreshHz) {
+                lcd->captureAccumulator -= lcd->refreshHz;
+                pxaLcdPrvScreenDataDma(lcd, lcd->fsadr[0], len);
+            }
+
+            return true;
+        }
+
+        // pallette data
+        if (len > sizeof(lcd->palette)) len = sizeof(lcd->palette);
+
+        pxaLcdPrvDma(lcd, lcd->palette, lcd->fsadr[0], len);
+        pxaLcdUpdatePalette(lcd, len);
+
+        if (lcd->ldcmd[0] & 0x00200000UL) lcd->lcsr |= 0x0100;  // set EOF is DMA 0 finished
+    }
+
+    return false;
+}
+
+uint32_t pxaLcdTick(struct PxaLcd *lcd) {
+    // Two events per refresh: start of frame with descriptor fetch and capture, and end of
+    // frame. Returns the number of ticks until the next event.
+    uint32_t ticks = PXA_LCD_TICKS_PER_FRAME;
 
     if (lcd->enbChanged) {
         if (lcd->lccr0 & 0x0001) {  // just got enabled
@@ -436,8 +676,6 @@ void pxaLcdTick(struct PxaLcd *lcd) {
 
     if (lcd->lccr0 & 0x0001) {  // enabled - do a frame
 
-        uint32_t descrAddr, len;
-
         if (lcd->lccr0 & 0x400) {  // got disabled
 
             lcd->lcsr |= 0x0001;  // disable happened
@@ -447,51 +685,30 @@ void pxaLcdTick(struct PxaLcd *lcd) {
             switch (lcd->state) {
                 case LCD_STATE_IDLE:
 
-                    if (lcd->fbr[0] & 1) {  // branch
-
-                        lcd->fbr[0] &= ~1UL;
-                        if (lcd->fbr[0] & 2) lcd->lcsr |= 0x0200;
-                        descrAddr = lcd->fbr[0] & ~0xFUL;
-                    } else
-                        descrAddr = lcd->fdadr[0];
-                    lcd->fdadr[0] = pxaLcdPrvGetWord(lcd, descrAddr + 0);
-                    lcd->fsadr[0] = pxaLcdPrvGetWord(lcd, descrAddr + 4);
-                    lcd->fidr[0] = pxaLcdPrvGetWord(lcd, descrAddr + 8);
-                    lcd->ldcmd[0] = pxaLcdPrvGetWord(lcd, descrAddr + 12);
-
-                    lcd->state = LCD_STATE_DMA_0_START;
-                    break;
-
-                case LCD_STATE_DMA_0_START:
-
-                    if (lcd->ldcmd[0] & 0x00400000UL)
-                        lcd->lcsr |= 0x0002;  // set SOF is DMA 0 started
-                    len = lcd->ldcmd[0] & 0x000FFFFFUL;
-
-                    if (lcd->ldcmd[0] & 0x04000000UL) {  // pallette data
-
-                        if (len > sizeof(lcd->palette)) len = sizeof(lcd->palette);
-
-                        pxaLcdPrvDma(lcd, lcd->palette, lcd->fsadr[0], len);
-                        pxaLcdUpdatePalette(lcd, len);
-                    } else {
-                        lcd->frameNum++;
-
-                        if (!(lcd->frameNum & 63)) pxaLcdPrvScreenDataDma(lcd, lcd->fsadr[0], len);
+                    if (pxaLcdPrvStartFrame(lcd)) {
+                        lcd->state = LCD_STATE_FRAME;
+                        ticks = LCD_TICKS_ACTIVE;
                     }
-
-                    lcd->state = LCD_STATE_DMA_0_END;
                     break;
 
-                case LCD_STATE_DMA_0_END:
+                case LCD_STATE_FRAME:
 
                     if (lcd->ldcmd[0] & 0x00200000UL)
                         lcd->lcsr |= 0x0100;  // set EOF is DMA 0 finished
                     lcd->state = LCD_STATE_IDLE;
+                    ticks = PXA_LCD_TICKS_PER_FRAME - LCD_TICKS_ACTIVE;
                     break;
             }
     }
     pxaLcdPrvUpdateInts(lcd);
+
+    return ticks;
+}
+
+void pxaLcdSetRefreshRate(struct PxaLcd *lcd, uint32_t refreshHz, uint32_t captureHz) {
+    lcd->refreshHz = refreshHz;
+    lcd->captureHz = captureHz > refreshHz ? refreshHz : captureHz;
+    lcd->captureAccumulator = 0;
 }
 
 uint32_t *pxaLcdGetPendingFrame(struct PxaLcd *lcd) {
@@ -500,8 +717,41 @@ uint32_t *pxaLcdGetPendingFrame(struct PxaLcd *lcd) {
 
 void pxaLcdResetPendingFrame(struct PxaLcd *lcd) { lcd->frame_pending = false; }
 
+const struct FrameDamageSpan *pxaLcdGetPendingFrameDamage(struct PxaLcd *lcd, uint32_t *nSpans) {
+    *nSpans = lcd->frame_pending ? lcd->nDamageSpans : 0;
+
+    return lcd->damageSpans;
+}
+
+void pxaLcdSetNativeFrameFormat(struct PxaLcd *lcd, bool enable) {
+    if (lcd->nativeOutput == enable) return;
+
+    lcd->nativeOutput = enable;
+    lcd->framebufferDirty = true;
+}
+
+enum FrameFormat pxaLcdGetPendingFrameFormat(struct PxaLcd *lcd) {
+    return (enum FrameFormat)lcd->frontFormat;
+}
+
+const uint32_t *pxaLcdGetPendingFramePalette(struct PxaLcd *lcd) { return lcd->front_palette; }
+
 void pxaLcdSetFramebufferDirty(struct PxaLcd *lcd) { lcd->framebufferDirty = true; }
 
+void pxaLcdMarkFramebufferDirty(struct PxaLcd *lcd, uint32_t offset, uint32_t size) {
+    if (size == 0 || lcd->rowBytes == 0) {
+        lcd->framebufferDirty = true;
+        return;
+    }
+
+    const uint32_t last = (offset + size - 1) / lcd->rowBytes;
+
+    for (uint32_t row = offset / lcd->rowBytes; row <= last && row < lcd->height; row++)
+        lcd->dirtyRows[row >> 5] |= 1u << (row & 31);
+
+    lcd->rowsDirty = true;
+}
+
 struct PxaLcd *pxaLcdInit(struct ArmMem *physMem, struct SoC *soc, struct SocIc *ic, uint16_t width,
                           uint16_t height) {
     struct PxaLcd *lcd = (struct PxaLcd *)malloc(sizeof(*lcd));
@@ -515,9 +765,25 @@ struct PxaLcd *pxaLcdInit(struct ArmMem *physMem, struct SoC *soc, struct SocIc
     lcd->width = width;
     lcd->height = height;
     lcd->soc = soc;
+    lcd->paletteExpandedBpp = PALETTE_EXPANDED_INVALID;
+
+    pxaLcdSetRefreshRate(lcd, PXA_LCD_REFRESH_HZ_DEFAULT, PXA_LCD_REFRESH_HZ_DEFAULT);
 
     lcd->front_buffer = (uint32_t *)malloc(width * height * 4);
     lcd->back_buffer = (uint32_t *)malloc(width * height * 4);
+    lcd->front_palette = (uint32_t *)calloc(2 * 256, sizeof(uint32_t));
+    lcd->back_palette = lcd->front_palette + 256;
+
+    lcd->rowWords = (height + 31) / 32;
+    lcd->dirtyRows = (uint32_t *)calloc(3 * lcd->rowWords, sizeof(uint32_t));
+    lcd->staleRows = lcd->dirtyRows + lcd->rowWords;
+    lcd->damageRows = lcd->staleRows + lcd->rowWords;
+    lcd->damageSpans =
+        (struct FrameDamageSpan *)malloc((height / 2 + 1) * sizeof(struct FrameDamageSpan));
+
+    if (!lcd->front_buffer || !lcd->back_buffer || !lcd->front_palette || !lcd->dirtyRows ||
+        !lcd->damageSpans)
+        ERR("cannot alloc LCD buffers");
 
     if (!memRegionAdd(physMem, PXA_LCD_BASE, PXA_LCD_SIZE, pxaLcdPrvMemAccessF, lcd))
         ERR("cannot add LCD to MEM\n");
@@ -4,6 +4,7 @@
 #define _PXA_LCD_H_
 
 #include "CPU.h"
+#include "SoC.h"
 #include "mem.h"
 #include "soc_IC.h"
 
@@ -11,18 +12,32 @@
 extern "C" {
 #endif
 
+#define PXA_LCD_REFRESH_HZ_DEFAULT 60
+#define PXA_LCD_REFRESH_HZ_MAX 240
+
+// The scheduler task runs in units of 1 / (refresh rate * PXA_LCD_TICKS_PER_FRAME)
+#define PXA_LCD_TICKS_PER_FRAME 16
+
 struct PxaLcd;
-struct SoC;
 
 struct PxaLcd *pxaLcdInit(struct ArmMem *physMem, struct SoC *soc, struct SocIc *ic, uint16_t width,
                           uint16_t heigh);
 
-void pxaLcdTick(struct PxaLcd *lcd);
+uint32_t pxaLcdTick(struct PxaLcd *lcd);
+
+// Frames are captured for the host at captureHz, which is capped at the refresh rate
+void pxaLcdSetRefreshRate(struct PxaLcd *lcd, uint32_t refreshHz, uint32_t captureHz);
 
 uint32_t *pxaLcdGetPendingFrame(struct PxaLcd *lcd);
 void pxaLcdResetPendingFrame(struct PxaLcd *lcd);
+const struct FrameDamageSpan *pxaLcdGetPendingFrameDamage(struct PxaLcd *lcd, uint32_t *nSpans);
+
+void pxaLcdSetNativeFrameFormat(struct PxaLcd *lcd, bool enable);
+enum FrameFormat pxaLcdGetPendingFrameFormat(struct PxaLcd *lcd);
+const uint32_t *pxaLcdGetPendingFramePalette(struct PxaLcd *lcd);
 
 void pxaLcdSetFramebufferDirty(struct PxaLcd *lcd);
+void pxaLcdMarkFramebufferDirty(struct PxaLcd *lcd, uint32_t offset, uint32_t size);
 
 #ifdef __cplusplus
 }
@@ -16,9 +16,19 @@ void ramBufferAllocate(struct RamBuffer* ramBuffer, size_t size) {
     ramBuffer->dirtyPagesSize = dirtyPageCount4 * 4;
     ramBuffer->dirtyPages = malloc(ramBuffer->dirtyPagesSize);
     memset(ramBuffer->dirtyPages, 0, ramBuffer->dirtyPagesSize);
+
+    size_t watchPageCount4 = (ramBuffer->size >> 15) + 1;
+
+    ramBuffer->watchPages = malloc(watchPageCount4 * 4);
+    memset(ramBuffer->watchPages, 0, watchPageCount4 * 4);
+
+    ramBuffer->watchReasons = malloc(watchPageCount4 * 32);
+    memset(ramBuffer->watchReasons, 0, watchPageCount4 * 32);
 }
 
 void ramBufferRelease(struct RamBuffer* ramBuffer) {
     free(ramBuffer->buffer);
     free(ramBuffer->dirtyPages);
+    free(ramBuffer->watchPages);
+    free(ramBuffer->watchReasons);
 }
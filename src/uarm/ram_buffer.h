@@ -12,18 +12,48 @@ extern "C" {
 #define RAM_BUFFER_MARK_DIRTY(buf, addr) \
     ((buf).dirtyPages[(addr) >> 14] |= (1u << (((addr) >> 9) & 0x1f)))
 
+// Watched pages are 1k (the smallest possible MMU page). Writes to a watched page take the
+// slow path in the RAM, which dispatches on the reasons the page is watched for. Stores to
+// other pages only pay for a single bit test.
+#define RAM_BUFFER_WATCH_PAGE_BITS 10
+
+// RAM that has been pulled into the icache or the PACE block cache
+#define RAM_BUFFER_WATCH_CODE 0x01
+#define RAM_BUFFER_WATCH_FRAMEBUFFER 0x02
+
+#define RAM_BUFFER_IS_WATCHED(buf, addr) \
+    ((buf).watchPages[(addr) >> 15] & (1u << (((addr) >> 10) & 0x1f)))
+#define RAM_BUFFER_WATCH_REASONS(buf, addr) \
+    ((buf).watchReasons[(addr) >> RAM_BUFFER_WATCH_PAGE_BITS])
+
+#define RAM_BUFFER_IS_CODE(buf, addr) (RAM_BUFFER_WATCH_REASONS(buf, addr) & RAM_BUFFER_WATCH_CODE)
+#define RAM_BUFFER_MARK_CODE(buf, addr) ramBufferWatch(&(buf), addr, RAM_BUFFER_WATCH_CODE)
+#define RAM_BUFFER_CLEAR_CODE(buf, addr) ramBufferUnwatch(&(buf), addr, RAM_BUFFER_WATCH_CODE)
+
 struct RamBuffer {
     size_t size;
     size_t dirtyPagesSize;
 
     uint32_t* buffer;
     uint32_t* dirtyPages;
+    uint32_t* watchPages;
+    uint8_t* watchReasons;
 };
 
 void ramBufferAllocate(struct RamBuffer* ramBuffer, size_t size);
 
 void ramBufferRelease(struct RamBuffer* ramBuffer);
 
+static inline void ramBufferWatch(struct RamBuffer* ramBuffer, uint32_t addr, uint8_t reason) {
+    ramBuffer->watchReasons[addr >> RAM_BUFFER_WATCH_PAGE_BITS] |= reason;
+    ramBuffer->watchPages[addr >> 15] |= 1u << ((addr >> 10) & 0x1f);
+}
+
+static inline void ramBufferUnwatch(struct RamBuffer* ramBuffer, uint32_t addr, uint8_t reason) {
+    if ((ramBuffer->watchReasons[addr >> RAM_BUFFER_WATCH_PAGE_BITS] &= ~reason) == 0)
+        ramBuffer->watchPages[addr >> 15] &= ~(1u << ((addr >> 10) & 0x1f));
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -27,6 +27,9 @@ class Scheduler {
     void RescheduleTaskAtLeast(uint32_t taskType, uint32_t batchTicks);
     inline void UnscheduleTask(uint32_t taskType);
 
+    // Ticks left until the task is dispatched next, rounded up. 0 if it is not scheduled.
+    uint32_t GetPendingTicks(uint32_t taskType) const;
+
     uint64_t CyclesToNextUpdate(uint64_t cyclesPerSecond);
 
     void Advance(uint64_t cycles, uint64_t cyclesPerSecond);
@@ -160,6 +163,16 @@ void Scheduler<T>::UnscheduleTask(uint32_t taskType) {
     UpdateNextUpdate();
 }
 
+template <typename T>
+uint32_t Scheduler<T>::GetPendingTicks(uint32_t taskType) const {
+    const Task& task{tasks[taskType]};
+
+    if (task.batchedTicks == 0) return 0;
+    if (task.nextUpdate <= accTime) return 1;
+
+    return (task.nextUpdate - accTime + task.period - 1) / task.period;
+}
+
 template <typename T>
 uint64_t Scheduler<T>::CyclesToNextUpdate(uint64_t cyclesPerSecond) {
     return ((nextUpdate - accTime) * cyclesPerSecond) / 1_sec + 1;
@@ -7,9 +7,12 @@
 #include "SoC.h"
 #include "cp15.h"
 #include "mem.h"
+#include "pace.h"
 #include "pace_patch.h"
 #include "patch_dispatch.h"
 #include "patches.h"
+#include "patches_native.h"
+#include "pc_sampler.h"
 #include "ram_buffer.h"
 #include "scheduler.h"
 #include "soc_AC97.h"
@@ -47,6 +50,7 @@
 #include "device.h"
 #include "keys.h"
 #include "peephole.h"
+#include "peephole_validate.h"
 #include "pxa270_IMC.h"
 #include "pxa270_KPC.h"
 #include "pxa270_UDC.h"
@@ -70,8 +74,15 @@
 
 #define EVENT_QUEUE_CAPACITY 64
 
-#define PCM_HZ_ENABLED 44300
-#define PCM_HZ_DISABLED (44100 / 3)
+// The PCM task runs at the AC97 frame rate, audio output is resampled to 44.1 kHz (or 14.7 kHz
+// while nobody listens)
+#define PCM_FRAME_HZ 48000
+#define PCM_OUTPUT_HZ_ENABLED 44100
+#define PCM_OUTPUT_HZ_DISABLED (44100 / 3)
+
+// AC97 frames per PCM dispatch. The codec consumes at most one sample per frame, and DMA
+// refills the TX FIFO to at least 8 samples between two blocks.
+#define PCM_BLOCK_FRAMES 8
 
 struct PenEvent {
     bool penDown;
@@ -150,6 +161,7 @@ struct SoC {
     PacePatch *pacePatch;
     PatchDispatch *patchDispatch;
     SyscallDispatch *syscallDispatch;
+    PcSampler *pcSampler;
 
     Keypad *kp;
     VSD *vSD;
@@ -209,15 +221,15 @@ static void socSetupScheduler(Scheduler<SoC> *scheduler) {
     // RTC: 1 Hz
     scheduler->ScheduleTask(SCHEDULER_TASK_RTC, 1_sec, 1);
 
-    // LCD: one frame every 64 ticks, 3 ticks per frame, 60 FPS -> 11.52 kHz
-    scheduler->ScheduleTask(SCHEDULER_TASK_LCD, 1_sec / (64 * 3 * 60), 1);
+    // LCD: two events per refresh, the LCD returns the distance to the next one
+    scheduler->ScheduleTask(SCHEDULER_TASK_LCD,
+                            1_sec / (PXA_LCD_REFRESH_HZ_DEFAULT * PXA_LCD_TICKS_PER_FRAME), 1);
 
     // Periodic tasks 0: every 36 timer ticks -> 102.4 kHz
     scheduler->ScheduleTask(SCHEDULER_TASK_AUX_1, 36_sec / 3686400ULL, 1);
 
-    // PCM -> run at 44.3 kHz (higher than 44.1 kHz to create backpressure and
-    // avoid underruns)
-    scheduler->ScheduleTask(SCHEDULER_TASK_PCM, 1_sec / PCM_HZ_DISABLED, 1);
+    // PCM: blocks of AC97 frames at 48 kHz
+    scheduler->ScheduleTask(SCHEDULER_TASK_PCM, 1_sec / PCM_FRAME_HZ, PCM_BLOCK_FRAMES);
 
     if (deviceI2sConnected()) {
         // I2S -> run at 44.1 kHz
@@ -258,12 +270,15 @@ SoC *socInit(void *romData, const uint32_t romSize, uint32_t sdNumSectors, SdSec
 
     soc->syscallDispatch = initSyscallDispatch(soc->cpu);
     registerPatches(soc->patchDispatch, soc->syscallDispatch);
+    registerNativePatches(soc->patchDispatch, soc->cpu);
 
     ramBufferAllocate(&soc->ramBuffer, deviceGetRamSize());
 
     soc->ram = ramInit(soc->mem, soc, RAM_BASE, deviceGetRamSize(), &soc->ramBuffer, true);
     if (!soc->ram) ERR("Cannot init RAM");
 
+    cpuSetCodePageTracking(soc->cpu, RAM_BASE, &soc->ramBuffer);
+
     soc->rom = romInit(soc->mem, ROM_BASE, romData, romSize);
     if (!soc->rom) ERR("Cannot init ROM1");
 
@@ -273,6 +288,12 @@ SoC *socInit(void *romData, const uint32_t romSize, uint32_t sdNumSectors, SdSec
     pacePatchInit(soc->pacePatch, ROM_BASE, peepholeBuffer, romSize);
     peepholeOptimize((uint32_t *)peepholeBuffer, romSize);
 
+#ifdef VALIDATE_PEEPHOLE
+    if (!peepholeValidate(soc->cpu, ROM_BASE, (const uint32_t *)romData,
+                          (uint32_t *)peepholeBuffer, romSize, 10000))
+        ERR("peephole validation failed\n");
+#endif
+
     switch (deviceGetRamTerminationStyle()) {
         case RamTerminationMirror:
 
@@ -603,16 +624,16 @@ uint32_t SoC::DispatchTicks(uint32_t clientType, uint32_t batchedTicks) {
             return 1;
 
         case SCHEDULER_TASK_LCD:
-            pxaLcdTick(lcd);
-            return 1;
+            return pxaLcdTick(lcd);
 
         case SCHEDULER_TASK_I2S:
             socI2sPeriodic(i2s);
             return 1;
 
         case SCHEDULER_TASK_PCM:
-            devicePcmPeriodic(dev);
-            return (pcmSuspended && enablePcmOutput) ? 0 : 1;
+            devicePcmPeriodic(dev, batchedTicks,
+                              enablePcmOutput ? PCM_OUTPUT_HZ_ENABLED : PCM_OUTPUT_HZ_DISABLED);
+            return (pcmSuspended && enablePcmOutput) ? 0 : PCM_BLOCK_FRAMES;
 
         case SCHEDULER_TASK_AUX_1:
             socCycleBatch0(this);
@@ -627,6 +648,13 @@ uint32_t SoC::DispatchTicks(uint32_t clientType, uint32_t batchedTicks) {
     }
 }
 
+static void socPrvSamplePc(SoC *soc) {
+    struct PcSample sample = {.mode = PcSampleModeSleep, .pc = 0, .lr = 0};
+    if (!soc->sleeping) cpuGetPcSample(soc->cpu, &sample);
+
+    pcSamplerRecord(soc->pcSampler, &sample);
+}
+
 uint64_t socRun(SoC *soc, uint64_t maxCycles, uint64_t cyclesPerSecond) {
     uint64_t cycles = 0;
 
@@ -634,9 +662,19 @@ uint64_t socRun(SoC *soc, uint64_t maxCycles, uint64_t cyclesPerSecond) {
         uint64_t cyclesToAdvance = soc->scheduler->CyclesToNextUpdate(cyclesPerSecond);
         if (cyclesToAdvance + cycles > maxCycles) cyclesToAdvance = maxCycles - cycles;
 
+        if (soc->pcSampler) {
+            const uint64_t cyclesToNextSample =
+                pcSamplerCyclesToNextSample(soc->pcSampler, cyclesPerSecond);
+
+            if (cyclesToAdvance > cyclesToNextSample) cyclesToAdvance = cyclesToNextSample;
+        }
+
         const uint64_t cyclesAdvanced =
             soc->sleeping ? cyclesToAdvance : cpuCycle(soc->cpu, cyclesToAdvance);
 
+        if (soc->pcSampler && pcSamplerAdvance(soc->pcSampler, cyclesAdvanced, cyclesPerSecond))
+            socPrvSamplePc(soc);
+
         soc->scheduler->Advance(cyclesAdvanced, cyclesPerSecond);
         cycles += cyclesAdvanced;
     }
@@ -648,8 +686,73 @@ uint32_t *socGetPendingFrame(SoC *soc) { return pxaLcdGetPendingFrame(soc->lcd);
 
 void socResetPendingFrame(SoC *soc) { return pxaLcdResetPendingFrame(soc->lcd); }
 
+void socSetNativeFrameFormat(struct SoC *soc, bool enable) {
+    pxaLcdSetNativeFrameFormat(soc->lcd, enable);
+}
+
+enum FrameFormat socGetPendingFrameFormat(struct SoC *soc) {
+    return pxaLcdGetPendingFrameFormat(soc->lcd);
+}
+
+const uint32_t *socGetPendingFramePalette(struct SoC *soc) {
+    return pxaLcdGetPendingFramePalette(soc->lcd);
+}
+
+const struct FrameDamageSpan *socGetPendingFrameDamage(struct SoC *soc, uint32_t *nSpans) {
+    return pxaLcdGetPendingFrameDamage(soc->lcd, nSpans);
+}
+
+void socSetLcdRefreshRate(struct SoC *soc, uint32_t refreshHz, uint32_t captureHz) {
+    if (refreshHz == 0 || refreshHz > PXA_LCD_REFRESH_HZ_MAX) return;
+
+    // Carry the position within the current frame over to the new rate, otherwise EOF would
+    // fire early if we are in the middle of a frame
+    const uint32_t pendingTicks = soc->scheduler->GetPendingTicks(SCHEDULER_TASK_LCD);
+
+    pxaLcdSetRefreshRate(soc->lcd, refreshHz, captureHz);
+    soc->scheduler->ScheduleTask(SCHEDULER_TASK_LCD, 1_sec / (refreshHz * PXA_LCD_TICKS_PER_FRAME),
+                                 pendingTicks > 0 ? pendingTicks : 1);
+}
+
 void socSetFramebufferDirty(struct SoC *soc) { pxaLcdSetFramebufferDirty(soc->lcd); }
 
+void socMarkFramebufferDirty(struct SoC *soc, uint32_t offset, uint32_t size) {
+    pxaLcdMarkFramebufferDirty(soc->lcd, offset, size);
+}
+
+void socCodePageWritten(struct SoC *soc, uint32_t ramOffset) {
+    cpuCodePageWritten(soc->cpu, ramOffset);
+}
+
+void socPredecodeRom(struct SoC *soc, const char *cachePath) {
+    cpuSetPredecodedRom(soc->cpu, ROM_BASE, romGetSize(soc->rom),
+                        romPredecode(soc->rom, cachePath));
+}
+
+bool socStartPcSampling(struct SoC *soc, uint32_t rateHz, const char *symbolPath) {
+    if (soc->pcSampler) pcSamplerDestroy(soc->pcSampler);
+    soc->pcSampler = pcSamplerInit(rateHz);
+
+    if (symbolPath && !pcSamplerLoadSymbols(soc->pcSampler, symbolPath)) {
+        fprintf(stderr, "unable to load symbols from %s\n", symbolPath);
+        return false;
+    }
+
+    return true;
+}
+
+void socWritePcSamples(struct SoC *soc, FILE *file) {
+    if (soc->pcSampler) pcSamplerWriteFolded(soc->pcSampler, file);
+}
+
+void socSetSyscallProfiling(struct SoC *soc, bool enable) {
+    patchDispatchSetProfiling(soc->patchDispatch, enable);
+}
+
+void socDumpSyscallProfile(struct SoC *soc, FILE *file, bool csv) {
+    patchDispatchDumpProfile(soc->patchDispatch, file, csv);
+}
+
 bool socSetFramebuffer(struct SoC *soc, uint32_t start, uint32_t size) {
     if (start < RAM_BASE || start - RAM_BASE + size > deviceGetRamSize()) {
         fprintf(stderr, "framebuffer not in RAM\n");
@@ -657,6 +760,7 @@ bool socSetFramebuffer(struct SoC *soc, uint32_t start, uint32_t size) {
     }
 
     ramSetFramebuffer(soc->ram, start, size);
+    paceInvalidateHostPages();
 
     return size != 0;
 }
@@ -672,16 +776,15 @@ void socSetPcmSuspended(struct SoC *soc, bool pcmSuspended) {
 
     soc->pcmSuspended = pcmSuspended;
     if (soc->enablePcmOutput)
-        soc->scheduler->RescheduleTask(SCHEDULER_TASK_PCM, pcmSuspended ? 0 : 1);
+        soc->scheduler->RescheduleTask(SCHEDULER_TASK_PCM, pcmSuspended ? 0 : PCM_BLOCK_FRAMES);
 }
 
 void socSetPcmOutputEnabled(struct SoC *soc, bool pcmOutputEnabled) {
     if (pcmOutputEnabled == soc->enablePcmOutput) return;
 
     soc->enablePcmOutput = pcmOutputEnabled;
-    soc->scheduler->ScheduleTask(SCHEDULER_TASK_PCM,
-                                 1_sec / (pcmOutputEnabled ? PCM_HZ_ENABLED : PCM_HZ_DISABLED),
-                                 soc->pcmSuspended ? 0 : 1);
+    const bool paused = pcmOutputEnabled && soc->pcmSuspended;
+    soc->scheduler->RescheduleTask(SCHEDULER_TASK_PCM, paused ? 0 : PCM_BLOCK_FRAMES);
 
     if (soc->audioQueue) audioQueueClear(soc->audioQueue);
 }
@@ -40,6 +40,13 @@ void socAC97clientAdd(struct SocAC97 *ac97, enum Ac97Codec which, Ac97CodecRegR
 bool socAC97clientClientWantData(struct SocAC97 *ac97, enum Ac97Codec which, uint32_t *dataPtr);
 void socAC97clientClientHaveData(struct SocAC97 *ac97, enum Ac97Codec which, uint32_t data);
 
+// Block variants. Reads stop at an empty FIFO and flag an underrun, the number of words read is
+// returned.
+uint32_t socAC97clientClientWantDataN(struct SocAC97 *ac97, enum Ac97Codec which, uint32_t *data,
+                                      uint32_t count);
+void socAC97clientClientHaveDataN(struct SocAC97 *ac97, enum Ac97Codec which, const uint32_t *data,
+                                  uint32_t count);
+
 #ifdef __cplusplus
 }
 #endif
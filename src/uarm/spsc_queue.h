@@ -0,0 +1,182 @@
+#ifndef _SPSC_QUEUE_H_
+#define _SPSC_QUEUE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+// Bounded lock-free queue for exactly one producer and one consumer thread. The capacity is
+// rounded up to a power of two.
+template <typename T>
+class SpscQueue {
+   public:
+    explicit SpscQueue(size_t capacity);
+
+    // Producer side, fails if the queue is full
+    bool Push(const T& item);
+    // Producer side, returns the number of items that fit
+    size_t PushN(const T* items, size_t count);
+    // Producer side, position of the next item that will be pushed
+    size_t GetPushIndex() const;
+
+    // Consumer side, fails if the queue is empty
+    bool Pop(T& item);
+    // Consumer side, returns the number of items popped
+    size_t PopN(T* items, size_t count);
+
+    // Consumer side, drops everything that has been pushed so far
+    void Clear();
+    // Consumer side, drops the items that were pushed before pushIndex
+    void DropUntil(size_t pushIndex);
+
+    size_t GetSize() const;
+    size_t GetCapacity() const;
+
+   private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    static size_t RoundCapacity(size_t capacity);
+
+   private:
+    const size_t capacity;
+    std::unique_ptr<T[]> items;
+
+    // Both indices count up without wrapping into the buffer; each is written by one side
+    // only. Each side keeps a stale copy of the other index on its own cache line and only
+    // reloads it if the copy says there is no room or nothing to pop.
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head{0};
+    size_t cachedTail{0};
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail{0};
+    size_t cachedHead{0};
+
+   private:
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// IMPLEMENTATION
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+SpscQueue<T>::SpscQueue(size_t capacity)
+    : capacity(RoundCapacity(capacity)), items(std::make_unique<T[]>(this->capacity)) {}
+
+template <typename T>
+size_t SpscQueue<T>::RoundCapacity(size_t capacity) {
+    size_t rounded = 1;
+    while (rounded < capacity) rounded <<= 1;
+
+    return rounded;
+}
+
+template <typename T>
+bool SpscQueue<T>::Push(const T& item) {
+    const size_t tail = this->tail.load(std::memory_order_relaxed);
+
+    if (tail - cachedHead == capacity) {
+        cachedHead = head.load(std::memory_order_acquire);
+        if (tail - cachedHead == capacity) return false;
+    }
+
+    items[tail & (capacity - 1)] = item;
+    this->tail.store(tail + 1, std::memory_order_release);
+
+    return true;
+}
+
+template <typename T>
+size_t SpscQueue<T>::PushN(const T* items, size_t count) {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    const size_t tail = this->tail.load(std::memory_order_relaxed);
+
+    if (capacity - (tail - cachedHead) < count) cachedHead = head.load(std::memory_order_acquire);
+    count = std::min(count, capacity - (tail - cachedHead));
+
+    const size_t offset = tail & (capacity - 1);
+    const size_t firstChunk = std::min(count, capacity - offset);
+
+    memcpy(&this->items[offset], items, firstChunk * sizeof(T));
+    memcpy(&this->items[0], items + firstChunk, (count - firstChunk) * sizeof(T));
+
+    this->tail.store(tail + count, std::memory_order_release);
+
+    return count;
+}
+
+template <typename T>
+size_t SpscQueue<T>::GetPushIndex() const {
+    return tail.load(std::memory_order_relaxed);
+}
+
+template <typename T>
+bool SpscQueue<T>::Pop(T& item) {
+    const size_t head = this->head.load(std::memory_order_relaxed);
+
+    if (cachedTail == head) {
+        cachedTail = tail.load(std::memory_order_acquire);
+        if (cachedTail == head) return false;
+    }
+
+    item = items[head & (capacity - 1)];
+    this->head.store(head + 1, std::memory_order_release);
+
+    return true;
+}
+
+template <typename T>
+size_t SpscQueue<T>::PopN(T* items, size_t count) {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    const size_t head = this->head.load(std::memory_order_relaxed);
+
+    if (cachedTail - head < count) cachedTail = tail.load(std::memory_order_acquire);
+    count = std::min(count, cachedTail - head);
+
+    const size_t offset = head & (capacity - 1);
+    const size_t firstChunk = std::min(count, capacity - offset);
+
+    memcpy(items, &this->items[offset], firstChunk * sizeof(T));
+    memcpy(items + firstChunk, &this->items[0], (count - firstChunk) * sizeof(T));
+
+    this->head.store(head + count, std::memory_order_release);
+
+    return count;
+}
+
+template <typename T>
+void SpscQueue<T>::Clear() {
+    cachedTail = tail.load(std::memory_order_acquire);
+    head.store(cachedTail, std::memory_order_release);
+}
+
+template <typename T>
+void SpscQueue<T>::DropUntil(size_t pushIndex) {
+    const size_t head = this->head.load(std::memory_order_relaxed);
+
+    // the items may have been popped already
+    if (static_cast<std::make_signed_t<size_t>>(pushIndex - head) <= 0) return;
+
+    // a stale cachedTail below the new head would make the pop side read unwritten slots
+    if (static_cast<std::make_signed_t<size_t>>(pushIndex - cachedTail) > 0)
+        cachedTail = pushIndex;
+
+    this->head.store(pushIndex, std::memory_order_release);
+}
+
+template <typename T>
+size_t SpscQueue<T>::GetSize() const {
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+}
+
+template <typename T>
+size_t SpscQueue<T>::GetCapacity() const {
+    return capacity;
+}
+
+#endif  // _SPSC_QUEUE_H_
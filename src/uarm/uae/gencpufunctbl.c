@@ -0,0 +1,123 @@
+// Build time generator for the opcode -> handler table that was previously assembled by
+// build_cpufunctbl at startup. Reads the handler list from cpustbl.c and writes C source
+// with const tables to stdout.
+//
+// Usage: gencpufunctbl cpustbl.c > cpufunctbl.c
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+// clang-format off
+#include "options.h"
+#include "readcpu.h"
+// clang-format on
+
+#define MAX_HANDLER_NAME 64
+
+static char names[65536][MAX_HANDLER_NAME];
+
+static void setHandler(unsigned int opcode, const char* name) {
+    snprintf(names[opcode], MAX_HANDLER_NAME, "%s", name);
+}
+
+static void readHandlers(FILE* file) {
+    char line[256];
+    char name[MAX_HANDLER_NAME];
+    int specific;
+    unsigned int opcode;
+
+    for (unsigned int i = 0; i < 65536; i++) {
+        if (i >> 12 == 0x0f)
+            setHandler(i, "op_line1111");
+        else if (i >> 12 == 0x0a)
+            setHandler(i, "op_line1010");
+        else
+            setHandler(i, "op_illg");
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "{ %63[^, ], %d, %u", name, &specific, &opcode) != 3) continue;
+        if (strcmp(name, "0") == 0) break;
+
+        if (specific != 0 || opcode > 0xffff) {
+            fprintf(stderr, "unsupported cpustbl entry: %s", line);
+            exit(1);
+        }
+
+        setHandler(opcode, name);
+    }
+}
+
+static void resolveMerges(void) {
+    read_table68k();
+    do_merges();
+
+    for (unsigned int opcode = 0; opcode < 65536; opcode++) {
+        if (table68k[opcode].mnemo == i_ILLG || table68k[opcode].clev > 0) continue;
+        if (table68k[opcode].handler == -1) continue;
+
+        const char* name = names[table68k[opcode].handler];
+        if (strcmp(name, "op_illg") == 0) {
+            fprintf(stderr, "opcode 0x%04x merges into an illegal handler\n", opcode);
+            exit(1);
+        }
+
+        setHandler(opcode, name);
+    }
+
+    free(table68k);
+}
+
+static void writeIntTable(const char* name, int (*entry)(int)) {
+    printf("const int %s[256] = {", name);
+
+    for (int i = 0; i < 256; i++) printf("%s%d,", i % 16 == 0 ? "\n    " : " ", entry(i));
+
+    printf("\n};\n\n");
+}
+
+static int lowestBit(int i) {
+    int j;
+    for (j = 0; j < 8; j++)
+        if (i & (1 << j)) break;
+
+    return j;
+}
+
+static int movemIndex1(int i) { return lowestBit(i); }
+
+static int movemIndex2(int i) { return 7 - lowestBit(i); }
+
+static int movemNext(int i) { return i & ~(1 << lowestBit(i)); }
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s cpustbl.c\n", argv[0]);
+        return 1;
+    }
+
+    FILE* file = fopen(argv[1], "r");
+    if (!file) {
+        fprintf(stderr, "unable to open %s\n", argv[1]);
+        return 1;
+    }
+
+    readHandlers(file);
+    fclose(file);
+
+    resolveMerges();
+
+    printf("// Generated by gencpufunctbl, do not edit.\n\n");
+    printf("#include \"UAE.h\"\n\n");
+    printf("// clang-format off\n\n");
+
+    writeIntTable("movem_index1", movemIndex1);
+    writeIntTable("movem_index2", movemIndex2);
+    writeIntTable("movem_next", movemNext);
+
+    printf("cpuop_func* const cpufunctbl[65536] = {\n");
+    for (unsigned int opcode = 0; opcode < 65536; opcode++)
+        printf("    %s,  // 0x%04x\n", names[opcode], opcode);
+    printf("};\n");
+
+    return 0;
+}
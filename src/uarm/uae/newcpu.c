@@ -6,10 +6,6 @@ struct flag_struct regflags;
 int areg_byteinc[] = {1, 1, 1, 1, 1, 1, 1, 2};
 int imm8_table[] = {8, 1, 2, 3, 4, 5, 6, 7};
 
-int movem_index1[256];
-int movem_index2[256];
-int movem_next[256];
-
 uae_u32 get_disp_ea_000(uae_u32 base, uae_u32 dp) {
   int reg = (dp >> 12) & 15;
   uae_s32 regd = regs.regs[reg];
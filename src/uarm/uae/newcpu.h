@@ -38,9 +38,9 @@ extern "C" {
 extern int areg_byteinc[];
 extern int imm8_table[];
 
-extern int movem_index1[256];
-extern int movem_index2[256];
-extern int movem_next[256];
+extern const int movem_index1[256];
+extern const int movem_index2[256];
+extern const int movem_next[256];
 
 typedef unsigned long cpuop_func(uae_u32) REGPARAM;
 
@@ -52,6 +52,8 @@ struct cputbl {
 };
 
 extern unsigned long op_illg(uae_u32) REGPARAM;
+extern unsigned long op_line1010(uae_u32) REGPARAM;
+extern unsigned long op_line1111(uae_u32) REGPARAM;
 
 typedef uae_u8 flagtype;
 
@@ -69,9 +71,49 @@ extern regstruct regs;
 #define m68k_dreg(r, num) ((r).regs[(num)])
 #define m68k_areg(r, num) (((r).regs + 8)[(num)])
 
-#define get_ibyte(o) get_byte(regs.pc + (o) + 1)
-#define get_iword(o) get_word(regs.pc + (o))
-#define get_ilong(o) get_long(regs.pc + (o))
+/* Instruction words prefetched by the PACE decode cache (see pace.c). Extension
+ * words inside the window are served from the cache, everything else goes to
+ * memory. */
+#define PACE_DECODE_WINDOW_WORDS 5
+
+struct PaceDecodedInstruction {
+  uae_u32 pc;
+  uae_u32 size; /* valid bytes in words */
+  uae_u32 codePage;
+  cpuop_func *handler;
+  uae_u16 words[PACE_DECODE_WINDOW_WORDS];
+};
+
+extern const struct PaceDecodedInstruction *paceCurrentInstruction;
+
+STATIC_INLINE uae_u32 pace_get_iword(uae_u32 o) {
+  const uae_u32 offset = regs.pc + o - paceCurrentInstruction->pc;
+
+  return offset + 2 <= paceCurrentInstruction->size
+             ? paceCurrentInstruction->words[offset >> 1]
+             : get_word(regs.pc + o);
+}
+
+STATIC_INLINE uae_u32 pace_get_ibyte(uae_u32 o) {
+  const uae_u32 offset = regs.pc + o - paceCurrentInstruction->pc;
+
+  return offset + 2 <= paceCurrentInstruction->size
+             ? paceCurrentInstruction->words[offset >> 1] & 0xff
+             : get_byte(regs.pc + o + 1);
+}
+
+STATIC_INLINE uae_u32 pace_get_ilong(uae_u32 o) {
+  const uae_u32 offset = regs.pc + o - paceCurrentInstruction->pc;
+
+  return offset + 4 <= paceCurrentInstruction->size
+             ? ((uae_u32)paceCurrentInstruction->words[offset >> 1] << 16) |
+                   paceCurrentInstruction->words[(offset >> 1) + 1]
+             : get_long(regs.pc + o);
+}
+
+#define get_ibyte(o) pace_get_ibyte(o)
+#define get_iword(o) pace_get_iword(o)
+#define get_ilong(o) pace_get_ilong(o)
 
 #define m68k_incpc(o) (regs.pc += (o))
 
@@ -94,6 +136,9 @@ extern void Exception(int, uaecptr);
 /* 68000 */
 extern struct cputbl op_smalltbl_3[];
 
+/* Generated by gencpufunctbl at build time */
+extern cpuop_func* const cpufunctbl[65536];
+
 #ifdef __cplusplus
 }
 #endif
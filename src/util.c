@@ -16,6 +16,13 @@ uint64_t timestampUsec() {
     return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
+uint64_t timestampNsec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
 void uarmAbort() {
 #ifdef __EMSCRIPTEN__
     __emscripten_abort();
@@ -23,3 +30,14 @@ void uarmAbort() {
     abort();
 #endif
 }
+
+uint64_t fnv1a64(const void* data, size_t size, uint64_t hash) {
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
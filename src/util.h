@@ -3,6 +3,7 @@
 #ifndef _UTIL_H_
 #define _UTIL_H_
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -20,13 +21,18 @@
 
 #define FORCE_INLINE inline __attribute__((always_inline))
 
+#define FNV1A64_INIT 0xcbf29ce484222325ull
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 uint64_t timestampUsec();
+uint64_t timestampNsec();
 void uarmAbort();
 
+uint64_t fnv1a64(const void* data, size_t size, uint64_t hash);
+
 #ifdef __cplusplus
 }
 #endif